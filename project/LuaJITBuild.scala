@@ -38,6 +38,7 @@ object LuaJITBuild {
     val luajitIncludes  = SettingKey[File]("luajit-includes")
 
     val luajitFiles = TaskKey[Seq[LuaJITPatchFile]]("luajit-files")
+    val luajitLinuxStatic = TaskKey[File]("luajit-linux-static")
   }
   import Keys._
 
@@ -91,11 +92,18 @@ object LuaJITBuild {
             make(luajitSourceDir.value, Seq("clean"), env)
             make(luajitSourceDir.value, Seq("default"), env)
             IO.copyFile(luajitSourceDir.value / outputFile, outTarget)
+            // The native benchmark stub links LuaJIT statically, like the real Civ V binary.
+            if(platform == "linux")
+              IO.copyFile(luajitSourceDir.value / "src" / "libluajit.a", patchDirectory / "luajit_linux.a")
             outTarget
           }
 
         LuaJITPatchFile(platform, outTarget)
       }
+    },
+    luajitLinuxStatic := {
+      luajitFiles.value
+      luajitCacheDir.value / "output" / "luajit_linux.a"
     }
   )
 }
@@ -53,16 +53,23 @@ object NativePatchBuild {
       (s"""static const char* ${symbol}_name = "$symbol";
           |__attribute__((section("MPPATCH_PROXY,MPPATCH_PROXY"), aligned(8))) char $symbol[8] asm ("_$symbol");
         """.stripMargin,
-       s"setupProxyFunction($symbol, ${symbol}_name);")
+       s"setupProxyFunction(transaction, $symbol, ${symbol}_name);",
+       s"requireSymbol(${symbol}_name);")
     }
 
     IO.write(target,
       s"""#import "c_rt.h"
          |#import "platform.h"
+         |#import "symbols.h"
          |
          |${proxies.map(_._1.trim).mkString("\n")}
+         |__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void requireProxySymbols() {
+         |  ${proxies.map(_._3.trim).mkString("\n  ")}
+         |}
          |__attribute__((constructor(CONSTRUCTOR_BINARY_INIT))) static void setupProxyFunctions() {
+         |  PatchTransaction* transaction = PatchTransaction_begin("proxy functions");
          |  ${proxies.map(_._2.trim).mkString("\n  ")}
+         |  PatchTransaction_commit(transaction);
          |}
        """.stripMargin)
   }
@@ -96,6 +103,9 @@ object NativePatchBuild {
     val commonIncludes = TaskKey[File]("native-patch-common-includes")
 
     val nativeVersions = TaskKey[Seq[PatchFile]]("native-patch-files")
+    val nativeBenchmark = TaskKey[File]("native-patch-benchmark")
+    val nativeTelemetryTool = TaskKey[File]("native-patch-telemetry-tool")
+    val nativeSymbolBenchmark = TaskKey[File]("native-patch-symbol-benchmark")
   }
   import Keys._
 
@@ -158,7 +168,7 @@ object NativePatchBuild {
               Seq())
             case "linux" => (linux_cc _, "elf"  , ".so" ,
               Seq(patchSourceDir.value / "linux"  , patchSourceDir.value / "posix", steamrtSDLDev.value),
-              Seq(steamrtSDL.value), Seq("-ldl"),
+              Seq(steamrtSDL.value), Seq("-ldl", "-lpthread"),
               Seq())
           }
         val fullSourcePath = Seq(patchSourceDir.value / "common", patchSourceDir.value / "inih",
@@ -200,7 +210,8 @@ object NativePatchBuild {
             cc(includePaths("-I") ++ Seq(
               "-m32", "-g", "-shared", "-O2", "--std=gnu11", "-Wall", "-fvisibility=hidden",
               "-o", targetFile, "-DMPPATCH_CIV_VERSION=\""+sha256+"\"", "-DMPPATCH_PLATFORM=\""+platform+"\"",
-              "-DMPPATCH_BUILDID=\""+buildId+"\"") ++ nasmOut ++ config_common_secureFlags ++
+              "-DMPPATCH_BUILDID=\""+buildId+"\"", "-DMPPATCH_MIN_LOG_LEVEL=LOG_LEVEL_"+config_native_log_level.toUpperCase) ++
+              nasmOut ++ config_common_secureFlags ++
               gccFlags ++ fullSourcePath.flatMap(x => allFiles(x, ".c")))
             targetDir
           }
@@ -208,6 +219,92 @@ object NativePatchBuild {
         PatchFile(platform, sha256, targetFile, IO.read(buildIdFile))
       }
       patches.toSeq
+    },
+
+    // Reader for the telemetry page published with enableTelemetry. Its layout is fixed, so a 32-bit build can read
+    // the page of any patch build.
+    nativeTelemetryTool := {
+      val logger   = streams.value.log
+      val toolsDir = patchBuildDir.value / "tools"
+      val source   = patchSourceDir.value / "tools" / "mppatch_telemetry.c"
+      val tool     = toolsDir / "mppatch_telemetry"
+      IO.createDirectory(toolsDir)
+      trackDependencies(patchCacheDir.value / "telemetry_tool",
+                        Set(source, patchSourceDir.value / "common" / "telemetry.h")) {
+        logger.info("Compiling telemetry reader")
+        linux_cc(Seq("-m32", "-O2", "--std=gnu11", "-Wall", "-I", dir(patchSourceDir.value / "common"),
+                     "-o", tool, source))
+        tool
+      }
+    },
+
+    // Checks and benchmarks symbol resolution on the host. The Mach-O code runs against a synthetic image, using the
+    // load command definitions in bench/include, and the ELF hash table lookup against the benchmark's own exports.
+    nativeSymbolBenchmark := {
+      val logger     = streams.value.log
+      val benchDir   = patchBuildDir.value / "benchmark"
+      val source     = patchSourceDir.value
+      val versionDir = (source / "versions").listFiles.find(_.getName.startsWith("linux_"))
+                         .getOrElse(sys.error("No Linux patch version."))
+      val sources    = Seq(source / "bench" / "symbol_lookup.c", source / "macos" / "symbol_image.c",
+                           source / "posix" / "symbols.c", source / "linux" / "elf_index.c")
+
+      IO.createDirectory(benchDir)
+      val bench = benchDir / "symbol_lookup"
+      trackDependencies(patchCacheDir.value / "benchmark_symbols",
+                        (sources ++ allFiles(source / "bench" / "include" / "mach-o", ".h") ++
+                         Seq(source / "macos" / "symbol_image.h", source / "posix" / "symbols.h",
+                             source / "linux" / "elf_index.h")).toSet) {
+        logger.info("Compiling symbol lookup benchmark")
+        linux_cc(Seq("-m32", "-O2", "--std=gnu11", "-Wall", "-rdynamic", "-Wl,--hash-style=both",
+                     "-I", dir(source / "bench" / "include"), "-I", dir(source / "common"),
+                     "-I", dir(source / "posix"), "-I", dir(source / "macos"), "-I", dir(source / "linux"),
+                     "-I", dir(versionDir), "-o", bench) ++ sources :+ "-ldl")
+        bench
+      }
+
+      val results = benchDir / "results_symbols.tsv"
+      logger.info(s"Running symbol lookup benchmark, writing results to $results")
+      assertProcess(Process(Seq(bench.toString, results.toString), benchDir) !)
+      results
+    },
+
+    // Host-side benchmark of the Linux patch, using a stub executable in place of Civ V.
+    nativeBenchmark := {
+      val logger     = streams.value.log
+      val benchDir   = patchBuildDir.value / "benchmark"
+      val patch      = nativeVersions.value.find(_.platform == "linux").getOrElse(sys.error("No Linux patch version."))
+      val luajit     = LuaJITBuild.Keys.luajitFiles.value.find(_.platform == "linux").get
+      val versionDir = patchSourceDir.value / "versions" / s"linux_${patch.version}"
+
+      IO.createDirectory(benchDir)
+      val stub = benchDir / "stub_civ5"
+      trackDependencies(patchCacheDir.value / "benchmark_stub",
+                        Set(patchSourceDir.value / "bench" / "stub_civ5.c",
+                            LuaJITBuild.Keys.luajitLinuxStatic.value)) {
+        logger.info("Compiling native benchmark stub")
+        linux_cc(Seq("-m32", "-O2", "--std=gnu11", "-Wall", "-no-pie", "-rdynamic",
+                     "-I", dir(LuaJITBuild.Keys.luajitIncludes.value), "-I", dir(versionDir),
+                     "-I", dir(patchSourceDir.value / "linux"),
+                     "-o", stub, patchSourceDir.value / "bench" / "stub_civ5.c",
+                     "-Wl,--whole-archive", LuaJITBuild.Keys.luajitLinuxStatic.value, "-Wl,--no-whole-archive",
+                     "-ldl", "-lm", "-lpthread"))
+        stub
+      }
+
+      // The patch looks for its support files next to the executable.
+      IO.copyFile(patch.file, benchDir / patch.file.getName)
+      IO.copyFile(luajit.file, benchDir / "mppatch_luajit.so")
+      IO.copyFile(steamrtSDL.value, benchDir / config_steam_sdlbin_name)
+      IO.write(benchDir / "mppatch_config.ini",
+        "[MPPatch]\nenableMultiplayerPatch = true\nenableLuaJIT = true\n")
+      IO.delete(benchDir / "mppatch_symbols.cache")
+
+      val results = benchDir / s"results_${patch.buildId.trim}.tsv"
+      logger.info(s"Running native benchmark, writing results to $results")
+      assertProcess(Process(Seq(stub.toString, (benchDir / patch.file.getName).toString, results.toString),
+                            benchDir, "LD_LIBRARY_PATH" -> benchDir.toString) !)
+      results
     }
   )
 }
@@ -0,0 +1,72 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// The subset of the 32-bit Mach-O load command definitions used by macos/symbol_image.c, so that it can be built and
+// benchmarked on Linux. The layouts match <mach-o/loader.h> from the macOS SDK.
+
+#pragma once
+
+#include <stdint.h>
+
+struct mach_header {
+    uint32_t magic;
+    int32_t  cputype;
+    int32_t  cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+};
+#define MH_MAGIC   0xfeedface
+#define MH_EXECUTE 0x2
+
+struct load_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+};
+#define LC_SEGMENT 0x1
+#define LC_SYMTAB  0x2
+
+struct segment_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char     segname[16];
+    uint32_t vmaddr;
+    uint32_t vmsize;
+    uint32_t fileoff;
+    uint32_t filesize;
+    int32_t  maxprot;
+    int32_t  initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+#define SEG_TEXT     "__TEXT"
+#define SEG_LINKEDIT "__LINKEDIT"
+
+struct symtab_command {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t symoff;
+    uint32_t nsyms;
+    uint32_t stroff;
+    uint32_t strsize;
+};
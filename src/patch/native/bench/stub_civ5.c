@@ -0,0 +1,213 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// A stand-in for the Linux Civ V binary, used to benchmark the native patch without launching the game. It exports
+// the hooked functions under their real mangled names, with the same number of relocatable bytes at their start that
+// the patch copies into its function fragments, and exports the whole Lua API from a statically linked LuaJIT.
+//
+// Usage: stub_civ5 <patch.so> <results.tsv> [iterations]
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "posix_defines.h"
+
+#define LuaTableHook_SENTINEL "216f0090-85dd-4061-8371-3d8ba2099a70"
+#define BENCHMARK_FORMAT      "mppatch-native-benchmark-v1"
+
+// Hooked functions
+//
+// Each entry point starts with exactly as many single-byte NOPs as the patch relocates, followed by a jump to the C
+// implementation.
+#define STR_(x) #x
+#define STR(x) STR_(x)
+#define STUB_ENTRY(symbol, hookLength, impl) \
+    __asm__(".text\n" \
+            ".globl " symbol "\n" \
+            ".type " symbol ", @function\n" \
+            symbol ":\n" \
+            ".fill " STR(hookLength) ", 1, 0x90\n" \
+            "jmp " impl "\n");
+
+int lGetMemoryUsage_impl(lua_State* L) {
+    lua_pushinteger(L, lua_gc(L, LUA_GCCOUNT, 0));
+    return 1;
+}
+STUB_ENTRY(lGetMemoryUsage_symbol, lGetMemoryUsage_hook_length, "lGetMemoryUsage_impl")
+int lGetMemoryUsage(lua_State* L) __asm__(lGetMemoryUsage_symbol);
+
+static volatile int lastListLength;
+int SetActiveDLCAndMods_impl(void* this, CppList* dlcList, CppList* modList, char reloadDlc, char reloadMods) {
+    int length = 0;
+    for(CppListLink* link = dlcList->next; link != dlcList; link = link->next) length++;
+    for(CppListLink* link = modList->next; link != modList; link = link->next) length++;
+    lastListLength = length;
+    return 1;
+}
+STUB_ENTRY(SetActiveDLCAndMods_symbol, SetActiveDLCAndMods_hook_length, "SetActiveDLCAndMods_impl")
+int SetActiveDLCAndMods(void* this, CppList* dlcList, CppList* modList, char reloadDlc, char reloadMods)
+    __asm__(SetActiveDLCAndMods_symbol);
+
+static CppList* emptyList() {
+    CppList* list = malloc(sizeof(CppListLink) + sizeof(int));
+    list->prev = list;
+    list->next = list;
+    *(int*) list->data = 0;
+    return list;
+}
+static CppList* stubDlcList;
+static CppList* stubModList;
+static int luaStub_setActiveDLCAndMods(lua_State* L) {
+    SetActiveDLCAndMods(NULL, stubDlcList, stubModList, 0, 0);
+    return 0;
+}
+
+// Benchmark harness
+static FILE* results;
+static uint64_t monotonicNanos() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+static void reportResult(const char* name, int iterations, uint64_t totalNanos) {
+    fprintf(results, "%s\t%d\t%llu\t%llu\n", name, iterations, (unsigned long long) totalNanos,
+            (unsigned long long) (totalNanos / iterations));
+    printf("%-32s %10d iterations %14.1f ns/op\n", name, iterations, (double) totalNanos / iterations);
+}
+
+// Runs a Lua chunk with (patch, iterations) as its arguments, and reports how long it took.
+static void runLuaBenchmark(lua_State* L, const char* name, int iterations, const char* code) {
+    if(luaL_loadstring(L, code)) {
+        fprintf(stderr, "Could not load benchmark %s: %s\n", name, lua_tostring(L, -1));
+        exit(1);
+    }
+    lua_getglobal(L, "patch");
+    lua_pushinteger(L, iterations);
+
+    uint64_t start = monotonicNanos();
+    if(lua_pcall(L, 2, 0, 0)) {
+        fprintf(stderr, "Benchmark %s failed: %s\n", name, lua_tostring(L, -1));
+        exit(1);
+    }
+    reportResult(name, iterations, monotonicNanos() - start);
+}
+
+static void reportStartupPhases(lua_State* L) {
+    lua_getglobal(L, "patch");
+    lua_getfield(L, -1, "startup");
+    lua_getfield(L, -1, "phases");
+    int phases = lua_gettop(L);
+    for(int i=1; i<=lua_objlen(L, phases); i++) {
+        lua_rawgeti(L, phases, i);
+        lua_getfield(L, -1, "name");
+        lua_getfield(L, -2, "durationMicros");
+
+        char name[64];
+        snprintf(name, sizeof(name), "startup.%s", lua_tostring(L, -2));
+        reportResult(name, 1, (uint64_t) lua_tointeger(L, -1) * 1000);
+        lua_pop(L, 3);
+    }
+    lua_pop(L, 3);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s <patch.so> <results.tsv> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 3 ? atoi(argv[3]) : 100000;
+    int cycleIterations = iterations / 10 > 0 ? iterations / 10 : 1;
+
+    results = fopen(argv[2], "w");
+    if(results == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(results, "# %s\n", BENCHMARK_FORMAT);
+    fprintf(results, "benchmark\titerations\ttotal_ns\tns_per_op\n");
+
+    // Loading the patch runs all of its constructors, including symbol resolution and LuaJIT patching.
+    uint64_t start = monotonicNanos();
+    void* patch = dlopen(argv[1], RTLD_NOW | RTLD_GLOBAL);
+    if(patch == NULL) {
+        fprintf(stderr, "Could not load patch: %s\n", dlerror());
+        return 1;
+    }
+    reportResult("startup.dlopen", 1, monotonicNanos() - start);
+
+    stubDlcList = emptyList();
+    stubModList = emptyList();
+
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+    lua_register(L, "GetMemoryUsage", lGetMemoryUsage);
+    lua_register(L, "GetMemoryUsageDirect", lGetMemoryUsage_impl);
+    lua_register(L, "SetActiveDLCAndMods", luaStub_setActiveDLCAndMods);
+    lua_pushstring(L, LuaTableHook_SENTINEL);
+    lua_setglobal(L, "SENTINEL");
+
+    // The first sentinel call builds the MPPatch table. Later ones return the cached copy.
+    start = monotonicNanos();
+    lua_getglobal(L, "GetMemoryUsage");
+    lua_pushstring(L, LuaTableHook_SENTINEL);
+    lua_call(L, 1, 1);
+    reportResult("lua.sentinel_first", 1, monotonicNanos() - start);
+    if(lua_type(L, -1) != LUA_TTABLE) {
+        fprintf(stderr, "The patch did not return the MPPatch table. Is enableMultiplayerPatch set?\n");
+        return 1;
+    }
+    lua_setglobal(L, "patch");
+    reportStartupPhases(L);
+
+    runLuaBenchmark(L, "lua.sentinel_cached", iterations,
+        "local _, n = ... local f, s = GetMemoryUsage, SENTINEL for i=1,n do f(s) end");
+    runLuaBenchmark(L, "lua.get_memory_usage_direct", iterations,
+        "local _, n = ... local f = GetMemoryUsageDirect for i=1,n do f() end");
+    runLuaBenchmark(L, "lua.get_memory_usage_proxied", iterations,
+        "local _, n = ... local f = GetMemoryUsage for i=1,n do f() end");
+
+    runLuaBenchmark(L, "netpatch.push_install_reset", cycleIterations,
+        "local patch, n = ... "
+        "local np, mods = patch.NetPatch, {} "
+        "for i=1,50 do mods[i] = { ID = string.format('%08x-0000-0000-0000-000000000000', i), Version = 1 } end "
+        "for i=1,n do np.pushMods(mods) np.overrideModList() np.install() np.reset() end");
+
+    runLuaBenchmark(L, "proxy.set_active_dlc_and_mods_direct", cycleIterations,
+        "local _, n = ... local f = SetActiveDLCAndMods for i=1,n do f() end");
+    runLuaBenchmark(L, "proxy.set_active_dlc_and_mods_hooked", cycleIterations,
+        "local patch, n = ... local f, install = SetActiveDLCAndMods, patch.NetPatch.install "
+        "for i=1,n do install() f() end");
+
+    lua_close(L);
+    fclose(results);
+    return 0;
+}
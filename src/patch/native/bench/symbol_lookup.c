@@ -0,0 +1,311 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Checks and benchmarks the symbol resolution used by the native patch, without needing a game binary. The Mach-O
+// symbol table code is run against a synthetic image built in memory, so it can be tested on Linux. The ELF hash table
+// lookup is run against this executable's own dynamic symbol table, which needs it to be linked with -rdynamic and
+// --hash-style=both, and compared with dlsym.
+//
+// Usage: symbol_lookup <results.tsv> [iterations]
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "symbols.h"
+#include "symbol_image.h"
+#include "elf_index.h"
+
+#define BENCHMARK_FORMAT "mppatch-native-benchmark-v1"
+
+__attribute__((noreturn)) void fatalError_fn(const char* message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+static int failures = 0;
+#define check(condition, format, arg...) { \
+    if(!(condition)) { \
+        fprintf(stderr, "Check failed: " format "\n", ##arg); \
+        failures++; \
+    } \
+}
+
+// Benchmark harness
+static FILE* results;
+static uint64_t monotonicNanos() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+static void reportResult(const char* name, int iterations, uint64_t totalNanos) {
+    fprintf(results, "%s\t%d\t%llu\t%llu\n", name, iterations, (unsigned long long) totalNanos,
+            (unsigned long long) (totalNanos / iterations));
+    printf("%-32s %10d iterations %14.1f ns/op\n", name, iterations, (double) totalNanos / iterations);
+}
+
+static void clearAddress(RequiredSymbol* symbol, void* data) {
+    symbol->address = NULL;
+}
+
+// Synthetic Mach-O image
+//
+// The image holds a __TEXT segment containing the load commands, and a __LINKEDIT segment with the symbol and string
+// tables. __LINKEDIT is mapped further from __TEXT than it is stored in the file, as in a real binary, so the table
+// offsets have to be translated from file offsets to addresses.
+#define MACHO_SYMBOLS       20000
+#define MACHO_TEXT_SIZE     0x2000
+#define MACHO_LINKEDIT_FILE 0x1000
+#define MACHO_STRIDE        50   // every MACHO_STRIDE-th symbol is required
+#define MACHO_MISSING       100  // required symbols that are not in the image
+
+typedef struct MachOImage {
+    struct mach_header header;
+    struct segment_command text;
+    struct segment_command linkedit;
+    struct symtab_command symtab;
+} MachOImage;
+
+static char* symbolNames[MACHO_SYMBOLS];
+static char* missingNames[MACHO_MISSING];
+
+static uint32_t symbolValue(int i) {
+    return 0x1000 + i * 16;
+}
+
+// Symbol 0 is defined twice, and the later definition is the one that should be resolved. There are also entries
+// with no name, which have to be skipped.
+static void* buildMachOImage(int* imageSize) {
+    int nsyms = MACHO_SYMBOLS + MACHO_SYMBOLS / 1000 + 1;
+    int strsize = 1;
+    for(int i=0; i<MACHO_SYMBOLS; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "_ZN12CvGameCore%dSymbol%05dEv", i % 7, i);
+        symbolNames[i] = strdup(name);
+        strsize += strlen(name) + 2; // leading underscore and terminator
+    }
+
+    int symoff = MACHO_LINKEDIT_FILE, stroff = symoff + nsyms * sizeof(struct nlist);
+    int linkeditSize = stroff + strsize - MACHO_LINKEDIT_FILE;
+    *imageSize = MACHO_TEXT_SIZE + linkeditSize;
+
+    char* image = calloc(1, *imageSize);
+    MachOImage* commands = (MachOImage*) image;
+    commands->header.magic      = MH_MAGIC;
+    commands->header.filetype   = MH_EXECUTE;
+    commands->header.ncmds      = 3;
+    commands->header.sizeofcmds = sizeof(MachOImage) - sizeof(struct mach_header);
+
+    commands->text.cmd     = LC_SEGMENT;
+    commands->text.cmdsize = sizeof(struct segment_command);
+    strcpy(commands->text.segname, SEG_TEXT);
+    commands->text.vmaddr   = 0;
+    commands->text.vmsize   = MACHO_TEXT_SIZE;
+    commands->text.fileoff  = 0;
+    commands->text.filesize = MACHO_LINKEDIT_FILE;
+
+    commands->linkedit.cmd     = LC_SEGMENT;
+    commands->linkedit.cmdsize = sizeof(struct segment_command);
+    strcpy(commands->linkedit.segname, SEG_LINKEDIT);
+    commands->linkedit.vmaddr   = MACHO_TEXT_SIZE;
+    commands->linkedit.vmsize   = linkeditSize;
+    commands->linkedit.fileoff  = MACHO_LINKEDIT_FILE;
+    commands->linkedit.filesize = linkeditSize;
+
+    commands->symtab.cmd     = LC_SYMTAB;
+    commands->symtab.cmdsize = sizeof(struct symtab_command);
+    commands->symtab.symoff  = symoff;
+    commands->symtab.nsyms   = nsyms;
+    commands->symtab.stroff  = stroff;
+    commands->symtab.strsize = strsize;
+
+    char* linkedit = image + MACHO_TEXT_SIZE - MACHO_LINKEDIT_FILE;
+    struct nlist* sym = (struct nlist*) (linkedit + symoff);
+    char* strings = linkedit + stroff;
+    int strx = 1;
+    for(int i=0; i<MACHO_SYMBOLS; i++) {
+        if(i % 1000 == 0) sym++; // unnamed entry
+        sym->n_un.n_strx = strx;
+        sym->n_type      = N_SECT | N_EXT;
+        sym->n_sect      = 1;
+        sym->n_value     = i == 0 ? 0 : symbolValue(i);
+        sym++;
+        strx += sprintf(strings + strx, "_%s", symbolNames[i]) + 1;
+    }
+    sym->n_un.n_strx = 1;
+    sym->n_type      = N_SECT | N_EXT;
+    sym->n_sect      = 1;
+    sym->n_value     = symbolValue(0);
+
+    return image;
+}
+
+static void testMachO(void* image, int imageSize, int iterations) {
+    SymbolImage symbols;
+    check(SymbolImage_parse(&symbols, image), "Synthetic Mach-O image could not be parsed.");
+    check(symbols.base == image, "Mach-O image base is %p, expected %p.", symbols.base, image);
+    check(symbols.size == (size_t) imageSize, "Mach-O image size is %zu, expected %d.", symbols.size, imageSize);
+    check(symbols.count == MACHO_SYMBOLS + MACHO_SYMBOLS / 1000 + 1,
+          "Mach-O symbol table has %u entries.", symbols.count);
+
+    int required = 0;
+    for(int i=0; i<MACHO_SYMBOLS; i += MACHO_STRIDE, required++) requireSymbol(symbolNames[i]);
+    for(int i=0; i<MACHO_MISSING; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "_ZN12CvGameCore%dMissing%05dEv", i % 7, i);
+        missingNames[i] = strdup(name);
+        requireSymbol(missingNames[i]);
+    }
+
+    int found = SymbolImage_resolveRequired(&symbols);
+    check(found == required, "Resolved %d required Mach-O symbols, expected %d.", found, required);
+    for(int i=0; i<MACHO_SYMBOLS; i += MACHO_STRIDE) {
+        RequiredSymbol* entry = RequiredSymbol_find(symbolNames[i], RequiredSymbol_hash(symbolNames[i]));
+        void* expected = image + symbolValue(i);
+        void* linear = SymbolImage_find(&symbols, symbolNames[i]);
+        check(entry != NULL && entry->address == expected, "%s resolved to %p, expected %p.",
+              symbolNames[i], entry ? entry->address : NULL, expected);
+        check(linear == expected, "Linear scan found %s at %p, expected %p.", symbolNames[i], linear, expected);
+    }
+    for(int i=0; i<MACHO_MISSING; i++) {
+        RequiredSymbol* entry = RequiredSymbol_find(missingNames[i], RequiredSymbol_hash(missingNames[i]));
+        check(entry != NULL && entry->address == NULL, "Missing symbol %s was resolved.", missingNames[i]);
+        check(SymbolImage_find(&symbols, missingNames[i]) == NULL, "Linear scan found missing symbol %s.",
+              missingNames[i]);
+    }
+
+    MachOImage* commands = (MachOImage*) image;
+    commands->header.ncmds = 2;
+    SymbolImage truncated;
+    check(!SymbolImage_parse(&truncated, image), "Mach-O image without LC_SYMTAB was parsed.");
+    commands->header.ncmds = 3;
+
+    // One pass resolving every required symbol, against a linear scan of the table for each of them.
+    uint64_t start = monotonicNanos();
+    for(int i=0; i<iterations; i++) {
+        RequiredSymbol_forEach(clearAddress, NULL);
+        SymbolImage_resolveRequired(&symbols);
+    }
+    reportResult("macho.resolve_required", iterations, monotonicNanos() - start);
+
+    start = monotonicNanos();
+    for(int i=0; i<iterations; i++) {
+        for(int j=0; j<MACHO_SYMBOLS; j += MACHO_STRIDE) SymbolImage_find(&symbols, symbolNames[j]);
+        for(int j=0; j<MACHO_MISSING; j++) SymbolImage_find(&symbols, missingNames[j]);
+    }
+    reportResult("macho.find_linear", iterations, monotonicNanos() - start);
+}
+
+// ELF hash tables
+//
+// Every symbol this executable exports is looked up through DT_GNU_HASH, DT_HASH and dlsym, along with the missing
+// names from the Mach-O test, which dlsym has to search every loaded object for.
+#define ELF_MAX_NAMES 4096
+
+static const char* elfNames[ELF_MAX_NAMES];
+static int elfNameCount = 0;
+
+static void benchmarkElfLookup(const char* name, const ElfSymbolIndex* index, int iterations) {
+    uint64_t start = monotonicNanos();
+    for(int i=0; i<iterations; i++) {
+        for(int j=0; j<elfNameCount; j++) ElfSymbolIndex_lookup(index, elfNames[j]);
+        for(int j=0; j<MACHO_MISSING; j++) ElfSymbolIndex_lookup(index, missingNames[j]);
+    }
+    reportResult(name, iterations, monotonicNanos() - start);
+}
+
+static void testElf(int iterations) {
+    ElfSymbolIndex index = {0};
+    ElfSymbolIndex_findExecutable(&index);
+    check(index.symtab != NULL && index.strtab != NULL, "Executable has no dynamic symbol table.");
+    check(index.gnuHash != NULL && index.sysvHash != NULL, "Executable was not linked with --hash-style=both.");
+    if(index.symtab == NULL || index.strtab == NULL || index.gnuHash == NULL || index.sysvHash == NULL) return;
+
+    // The DT_HASH chain array has one entry per symbol.
+    uint32_t symbolCount = index.sysvHash[1];
+    for(uint32_t i=1; i<symbolCount && elfNameCount<ELF_MAX_NAMES; i++) {
+        const ElfW(Sym)* sym = &index.symtab[i];
+        int type = ELF32_ST_TYPE(sym->st_info); // the same as ELF64_ST_TYPE
+        if(sym->st_shndx == SHN_UNDEF || sym->st_name == 0 || (type != STT_FUNC && type != STT_OBJECT)) continue;
+        elfNames[elfNameCount++] = index.strtab + sym->st_name;
+    }
+    check(elfNameCount > 0, "Executable exports no symbols. Was it linked with -rdynamic?");
+
+    ElfSymbolIndex gnuIndex = index, sysvIndex = index;
+    gnuIndex.sysvHash = NULL;
+    sysvIndex.gnuHash = NULL;
+    for(int i=0; i<elfNameCount; i++) {
+        void* expected = dlsym(RTLD_DEFAULT, elfNames[i]);
+        void* gnu = ElfSymbolIndex_lookup(&gnuIndex, elfNames[i]);
+        void* sysv = ElfSymbolIndex_lookup(&sysvIndex, elfNames[i]);
+        check(gnu == expected, "DT_GNU_HASH found %s at %p, dlsym at %p.", elfNames[i], gnu, expected);
+        check(sysv == expected, "DT_HASH found %s at %p, dlsym at %p.", elfNames[i], sysv, expected);
+    }
+    for(int i=0; i<MACHO_MISSING; i++) {
+        check(ElfSymbolIndex_lookup(&gnuIndex, missingNames[i]) == NULL, "DT_GNU_HASH found %s.", missingNames[i]);
+        check(ElfSymbolIndex_lookup(&sysvIndex, missingNames[i]) == NULL, "DT_HASH found %s.", missingNames[i]);
+    }
+
+    int lookups = iterations * 100;
+    benchmarkElfLookup("elf.gnu_hash", &gnuIndex, lookups);
+    benchmarkElfLookup("elf.sysv_hash", &sysvIndex, lookups);
+
+    uint64_t start = monotonicNanos();
+    for(int i=0; i<lookups; i++) {
+        for(int j=0; j<elfNameCount; j++) dlsym(RTLD_DEFAULT, elfNames[j]);
+        for(int j=0; j<MACHO_MISSING; j++) dlsym(RTLD_DEFAULT, missingNames[j]);
+    }
+    reportResult("elf.dlsym", lookups, monotonicNanos() - start);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s <results.tsv> [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+    results = fopen(argv[1], "w");
+    if(results == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(results, "# %s\n", BENCHMARK_FORMAT);
+    fprintf(results, "benchmark\titerations\ttotal_ns\tns_per_op\n");
+
+    int imageSize;
+    void* image = buildMachOImage(&imageSize);
+    testMachO(image, imageSize, iterations);
+    testElf(iterations);
+
+    fclose(results);
+    if(failures != 0) {
+        fprintf(stderr, "%d checks failed.\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -31,6 +31,8 @@
 #include "c_rt.h"
 #include "platform.h"
 #include "config.h"
+#include "sync.h"
+#include "startup_profile.h"
 
 // Get executable path
 __attribute__((constructor(CONSTRUCTOR_GET_EXE_PATH))) static void initExecutablePath() {
@@ -38,14 +40,6 @@ __attribute__((constructor(CONSTRUCTOR_GET_EXE_PATH))) static void initExecutabl
     debug_print("Executable base directory: %s", executable_directory_path);
 }
 
-// Debug logging
-FILE* debug_log_file = NULL;
-__attribute__((constructor(CONSTRUCTOR_LOGGING))) static void initDebugLogging() {
-    char buffer[PATH_MAX];
-    getSupportFilePath(buffer, "mppatch_debug.log");
-    if(enableLogging) debug_log_file = fopen(buffer, "w");
-}
-
 // Misc utilities
 bool endsWith(const char* str, const char* ending) {
     size_t str_len = strlen(str), ending_len = strlen(ending);
@@ -56,12 +50,84 @@ bool fileExists(const char* file) {
 }
 
 // std::list implementation
+//
+// Links are allocated from per-size pools of contiguous slabs. Each link is preceded by a small hidden header naming
+// its pool, so the std::list layout the game sees is unchanged. Cleared links go back on their pool's free list instead
+// of being freed, and are pushed so that the next list built from that pool reuses them in the same order, keeping
+// traversal sequential in memory. Slabs are never returned to the system, so once the override lists have reached
+// their steady-state size, building and clearing them performs no allocation at all.
+#define LINK_POOL_COUNT      8
+#define LINK_POOL_SLAB_LINKS 64
+
+typedef struct LinkPool {
+    int slotSize;
+    CppListLink* freeList; // chained through link->next
+} LinkPool;
+typedef struct LinkHeader {
+    LinkPool* pool;
+    char padding[8 - sizeof(LinkPool*)];
+} LinkHeader;
+#define linkHeader(link) (((LinkHeader*) (link)) - 1)
+
+static LinkPool linkPools[LINK_POOL_COUNT];
+static CppListLinkStats linkStats;
+static Mutex linkPoolLock = MUTEX_INITIALIZER;
+
+static LinkPool* findLinkPool(int length) {
+    int slotSize = (sizeof(LinkHeader) + sizeof(CppListLink) + length + 7) & ~7;
+    for(int i=0; i<LINK_POOL_COUNT; i++) {
+        if(linkPools[i].slotSize == slotSize) return &linkPools[i];
+        if(linkPools[i].slotSize == 0) {
+            linkPools[i].slotSize = slotSize;
+            return &linkPools[i];
+        }
+    }
+    fatalError("Too many std::list link sizes in use. (slot size: %d)", slotSize);
+}
+static void pushFreeLink(CppListLink* link) {
+    LinkPool* pool = linkHeader(link)->pool;
+    link->next = pool->freeList;
+    pool->freeList = link;
+}
+static void allocateSlab(LinkPool* pool, int links) {
+    char* slab = malloc(pool->slotSize * links);
+    if(slab == NULL) fatalError("Could not allocate std::list links. (slot size: %d)", pool->slotSize);
+    for(int i = links - 1; i >= 0; i--) {
+        LinkHeader* header = (LinkHeader*) (slab + i * pool->slotSize);
+        header->pool = pool;
+        pushFreeLink((CppListLink*) (header + 1));
+    }
+
+    linkStats.slabAllocations++;
+    linkStats.bytesAllocated += pool->slotSize * links;
+}
+
 CppListLink* CppListLink_alloc(int length) {
-    CppListLink* link = (CppListLink*) malloc(sizeof(CppListLink) + length);
+    Mutex_lock(&linkPoolLock);
+    LinkPool* pool = findLinkPool(length);
+    if(pool->freeList == NULL) allocateSlab(pool, LINK_POOL_SLAB_LINKS);
+    CppListLink* link = pool->freeList;
+    pool->freeList = link->next;
+    linkStats.linkAllocations++;
+    linkStats.linksLive++;
+    Mutex_unlock(&linkPoolLock);
+
     link->next = link;
     link->prev = link;
     return link;
 }
+void CppListLink_reserve(int length, int count) {
+    Mutex_lock(&linkPoolLock);
+    LinkPool* pool = findLinkPool(length);
+    int available = 0;
+    for(CppListLink* link = pool->freeList; link != NULL && available < count; link = link->next) available++;
+    if(available < count) {
+        // Reserved links are allocated as one slab, so that a list built from them is contiguous.
+        int needed = count - available;
+        allocateSlab(pool, needed < LINK_POOL_SLAB_LINKS ? LINK_POOL_SLAB_LINKS : needed);
+    }
+    Mutex_unlock(&linkPoolLock);
+}
 void* CppListLink_newLink(CppListLink* list, int length) {
     CppListLink* link = CppListLink_alloc(length);
 
@@ -74,19 +140,33 @@ void* CppListLink_newLink(CppListLink* list, int length) {
     return link->data;
 }
 void CppListLink_clear(CppListLink* list) {
-    CppListLink* link = list->next;
+    Mutex_lock(&linkPoolLock);
+    CppListLink* link = list->prev;
     while(link != list) {
-        CppListLink* nextLink = link->next;
-        free(link);
-        link = nextLink;
+        CppListLink* prevLink = link->prev;
+        pushFreeLink(link);
+        linkStats.linkFrees++;
+        linkStats.linksLive--;
+        link = prevLink;
     }
+    Mutex_unlock(&linkPoolLock);
 
     list->prev = list;
     list->next = list;
 }
 void CppListLink_free(CppListLink* list) {
     CppListLink_clear(list);
-    free(list);
+
+    Mutex_lock(&linkPoolLock);
+    pushFreeLink(list);
+    linkStats.linkFrees++;
+    linkStats.linksLive--;
+    Mutex_unlock(&linkPoolLock);
+}
+void CppListLink_getStats(CppListLinkStats* stats) {
+    Mutex_lock(&linkPoolLock);
+    *stats = linkStats;
+    Mutex_unlock(&linkPoolLock);
 }
 
 // Patch writing code
@@ -96,6 +176,7 @@ static void writeJmpInstruction(void* fromAddress, void* toAddress, const char*
 
     *((char*)(fromAddress    )) = 0xe9;
     *((int *)(fromAddress + 1)) = offsetDiff;
+    StartupProfile_count(STARTUP_COUNTER_JUMPS_WRITTEN, 1);
 }
 void patchJmpInstruction(void* fromAddress, void* toAddress, const char* logReason) {
     memory_oldProtect protectFlags;
@@ -104,7 +185,114 @@ void patchJmpInstruction(void* fromAddress, void* toAddress, const char* logReas
     protectMemoryRegion(fromAddress, 5, &protectFlags);
 }
 
-PatchInformation* proxyFunction(void* fromAddress, void* toAddress, int patchBytes, const char* logReason) {
+// Patch transactions
+#define PATCH_PAGE_SIZE 4096 // x86 page size on every platform we support
+
+typedef struct PendingPatch {
+    void* fromAddress;
+    void* toAddress;
+    char* logReason;
+    ExecutableMemory* fragment; // prepared on commit, right before the jump that makes it reachable
+} PendingPatch;
+struct PatchTransaction {
+    const char* name;
+    PendingPatch* patches;
+    int count, capacity;
+};
+
+PatchTransaction* startupPatches;
+static PatchStats patchStats;
+
+PatchTransaction* PatchTransaction_begin(const char* name) {
+    PatchTransaction* transaction = malloc(sizeof(PatchTransaction));
+    transaction->name     = name;
+    transaction->patches  = NULL;
+    transaction->count    = 0;
+    transaction->capacity = 0;
+    return transaction;
+}
+void PatchTransaction_patchJmp(PatchTransaction* transaction, void* fromAddress, void* toAddress,
+                               const char* logReason) {
+    if(transaction->count == transaction->capacity) {
+        transaction->capacity = transaction->capacity == 0 ? 64 : transaction->capacity * 2;
+        transaction->patches  = realloc(transaction->patches, sizeof(PendingPatch) * transaction->capacity);
+        if(transaction->patches == NULL) fatalError("Could not allocate patch transaction %s.", transaction->name);
+    }
+
+    PendingPatch* patch = &transaction->patches[transaction->count++];
+    patch->fromAddress = fromAddress;
+    patch->toAddress   = toAddress;
+    patch->logReason   = strdup(logReason);
+    patch->fragment    = NULL;
+}
+
+static int comparePendingPatch(const void* a, const void* b) {
+    size_t addrA = (size_t) ((PendingPatch*) a)->fromAddress, addrB = (size_t) ((PendingPatch*) b)->fromAddress;
+    return addrA < addrB ? -1 : addrA > addrB ? 1 : 0;
+}
+#define pageStart(addr) ((size_t) (addr) & ~(size_t) (PATCH_PAGE_SIZE - 1))
+#define pageEnd(addr)   pageStart((size_t) (addr) + 5 + PATCH_PAGE_SIZE - 1)
+void PatchTransaction_commit(PatchTransaction* transaction) {
+    // Fragments are left writable until now so that a transaction's fragments can share an arena page.
+    for(int i=0; i<transaction->count; i++)
+        if(transaction->patches[i].fragment != NULL) executable_prepare(transaction->patches[i].fragment);
+
+    qsort(transaction->patches, transaction->count, sizeof(PendingPatch), comparePendingPatch);
+
+    int ranges = 0;
+    for(int i=0; i<transaction->count;) {
+        // Find every patch that touches this run of contiguous pages.
+        size_t rangeStart = pageStart(transaction->patches[i].fromAddress);
+        size_t rangeEnd   = pageEnd  (transaction->patches[i].fromAddress);
+        int j = i + 1;
+        while(j < transaction->count && pageStart(transaction->patches[j].fromAddress) <= rangeEnd) {
+            if(transaction->patches[j].fromAddress < transaction->patches[j - 1].fromAddress + 5)
+                fatalError("Overlapping patches in transaction %s: %s and %s", transaction->name,
+                           transaction->patches[j - 1].logReason, transaction->patches[j].logReason);
+            rangeEnd = pageEnd(transaction->patches[j].fromAddress);
+            j++;
+        }
+
+        memory_oldProtect protectFlags;
+        unprotectMemoryRegion((void*) rangeStart, rangeEnd - rangeStart, &protectFlags);
+        for(int k=i; k<j; k++) {
+            PendingPatch* patch = &transaction->patches[k];
+            writeJmpInstruction(patch->fromAddress, patch->toAddress, patch->logReason);
+            free(patch->logReason);
+        }
+        protectMemoryRegion((void*) rangeStart, rangeEnd - rangeStart, &protectFlags);
+
+        ranges++;
+        i = j;
+    }
+
+    if(transaction->count > 0) {
+        int saved = (transaction->count - ranges) * 2;
+        debug_print("Committed patch transaction %s: %d patches in %d page ranges (%d protection calls saved)",
+                    transaction->name, transaction->count, ranges, saved);
+        __sync_fetch_and_add(&patchStats.transactions     , 1);
+        __sync_fetch_and_add(&patchStats.patches          , transaction->count);
+        __sync_fetch_and_add(&patchStats.protectCalls     , ranges * 2);
+        __sync_fetch_and_add(&patchStats.protectCallsSaved, saved);
+    }
+
+    free(transaction->patches);
+    free(transaction);
+}
+void Patch_getStats(PatchStats* stats) {
+    *stats = patchStats;
+}
+
+__attribute__((constructor(CONSTRUCTOR_BINARY_INIT_EARLY))) static void beginStartupPatches() {
+    startupPatches = PatchTransaction_begin("startup");
+}
+__attribute__((constructor(CONSTRUCTOR_HOOK_COMMIT))) static void commitStartupPatches() {
+    PatchTransaction_commit(startupPatches);
+    startupPatches = NULL;
+}
+
+PatchInformation* PatchTransaction_proxyFunction(PatchTransaction* transaction, void* fromAddress, void* toAddress,
+                                                 int patchBytes, const char* logReason) {
     if(!fromAddress) fatalError("Could not resolve proxy target: %s", logReason)
     debug_print("Proxying function (%s) - %p => %p (%d bytes)", logReason, fromAddress, toAddress, patchBytes);
 
@@ -120,15 +308,20 @@ PatchInformation* proxyFunction(void* fromAddress, void* toAddress, int patchByt
 
         snprintf(buffer, 1024, "function fragment epilogue for %s", logReason);
         writeJmpInstruction(info->functionFragment->data + patchBytes, fromAddress + patchBytes, buffer);
-
-        executable_prepare(info->functionFragment);
     } else info->functionFragment = NULL;
 
     snprintf(buffer, 1024, "hook for %s", logReason);
-    patchJmpInstruction(fromAddress, toAddress, buffer);
+    PatchTransaction_patchJmp(transaction, fromAddress, toAddress, buffer);
+    transaction->patches[transaction->count - 1].fragment = info->functionFragment;
 
     return info;
 }
+PatchInformation* proxyFunction(void* fromAddress, void* toAddress, int patchBytes, const char* logReason) {
+    PatchTransaction* transaction = PatchTransaction_begin(logReason);
+    PatchInformation* info = PatchTransaction_proxyFunction(transaction, fromAddress, toAddress, patchBytes, logReason);
+    PatchTransaction_commit(transaction);
+    return info;
+}
 void unpatchCode(PatchInformation* info) {
     memory_oldProtect protectFlags;
     debug_print("Unpatching at %p", info->offset);
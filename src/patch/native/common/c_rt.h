@@ -40,23 +40,25 @@
 #define CONSTRUCTOR_BINARY_INIT       310
 #define CONSTRUCTOR_PROXY_INIT        320
 #define CONSTRUCTOR_HOOK_INIT         400
+#define CONSTRUCTOR_HOOK_COMMIT       410
+
+#include "debug_log.h"
 
 extern FILE* debug_log_file;
-#define debug_print_raw(format, arg...) { \
-    time_t time_val = time(NULL); \
-    char* time_str_tmp = asctime(localtime(&time_val)); \
-    time_str_tmp[strlen(time_str_tmp) - 1] = 0; \
-    char debug_print_buffer[2048]; \
-    snprintf(debug_print_buffer, 2048, "[%s] " format "\n", time_str_tmp, ##arg); \
-    debug_print_buffer[2047] = '\0'; \
-    fprintf(stderr, "[MPPatch] %s", debug_print_buffer); \
-    if(debug_log_file != NULL && enableLogging) { \
-        fprintf(debug_log_file, "%s", debug_print_buffer); \
-        fflush(debug_log_file); \
+#define debug_log_site(level, isRaw, format, arg...) { \
+    if(debugLog_isEnabled(level)) { \
+        static DebugLogCallSite debug_print_site = { __PRETTY_FUNCTION__, __FILE__, __LINE__, isRaw }; \
+        debugLog_write(&debug_print_site, format, ##arg); \
     } \
 }
-#define debug_print(format, arg...) \
-    debug_print_raw("%s at %s:%u - " format, __PRETTY_FUNCTION__, strrchr(__FILE__, '/') + 1, __LINE__, ##arg)
+#define debug_log(level, format, arg...) debug_log_site(level, false, format, ##arg)
+
+#define debug_print_raw(format, arg...) debug_log_site(LOG_LEVEL_DEBUG, true, format, ##arg)
+#define debug_trace(format, arg...)     debug_log(LOG_LEVEL_TRACE, format, ##arg)
+#define debug_print(format, arg...)     debug_log(LOG_LEVEL_DEBUG, format, ##arg)
+#define debug_info(format, arg...)      debug_log(LOG_LEVEL_INFO , format, ##arg)
+#define debug_warn(format, arg...)      debug_log(LOG_LEVEL_WARN , format, ##arg)
+#define debug_error(format, arg...)     debug_log(LOG_LEVEL_ERROR, format, ##arg)
 
 #define ENTRY __attribute__((force_align_arg_pointer))
 
@@ -67,10 +69,20 @@ const char* executable_directory_path;
 bool endsWith(const char* str, const char* ending);
 bool fileExists(const char* file);
 
+typedef struct CppListLinkStats {
+    uint32_t slabAllocations;
+    uint32_t bytesAllocated;
+    uint32_t linkAllocations;
+    uint32_t linkFrees;
+    uint32_t linksLive;
+} CppListLinkStats;
+
 CppListLink* CppListLink_alloc(int length);
+void CppListLink_reserve(int length, int count);
 void* CppListLink_newLink(CppListLink* list, int length);
 void CppListLink_clear(CppListLink* list);
 void CppListLink_free(CppListLink* list);
+void CppListLink_getStats(CppListLinkStats* stats);
 
 typedef struct PatchInformation {
     void* offset;
@@ -82,3 +94,22 @@ void patchJmpInstruction(void* fromAddress, void* toAddress, const char* logReas
 PatchInformation* proxyFunction(void* fromAddress, void* toAddress, int patchBytes, const char* logReason);
 void unpatchCode(PatchInformation* data);
 void unpatch(PatchInformation* data);
+
+// Patch transactions queue jump writes, and apply them all at once with a single unprotect/protect pair per range of
+// adjacent pages. Patches queued to startupPatches are committed once all hooks have been set up.
+typedef struct PatchTransaction PatchTransaction;
+typedef struct PatchStats {
+    uint32_t transactions;
+    uint32_t patches;
+    uint32_t protectCalls;
+    uint32_t protectCallsSaved;
+} PatchStats;
+extern PatchTransaction* startupPatches;
+
+PatchTransaction* PatchTransaction_begin(const char* name);
+void PatchTransaction_patchJmp(PatchTransaction* transaction, void* fromAddress, void* toAddress,
+                               const char* logReason);
+PatchInformation* PatchTransaction_proxyFunction(PatchTransaction* transaction, void* fromAddress, void* toAddress,
+                                                 int patchBytes, const char* logReason);
+void PatchTransaction_commit(PatchTransaction* transaction);
+void Patch_getStats(PatchStats* stats);
@@ -0,0 +1,157 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "sync.h"
+#include "chunk_cache.h"
+
+#include "lua.h"
+
+luaL_loadbuffer_t ChunkCache_originalLoadBuffer;
+
+// Entries are keyed by chunk name, length and a hash of the source, so an updated file is simply compiled again.
+typedef struct ChunkEntry {
+    uint64_t key;
+    char* name;
+    size_t sourceLength;
+    char* bytecode;
+    size_t bytecodeLength;
+    uint64_t compileNanos;
+} ChunkEntry;
+static ChunkEntry entries[CHUNK_CACHE_MAX_ENTRIES];
+static ChunkCacheStats cacheStats;
+static Mutex cacheLock = MUTEX_INITIALIZER;
+
+static uint64_t hashChunk(const char* name, const char* buff, size_t sz) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 1099511628211ULL;
+    for(size_t i=0; i<sz; i++) hash = (hash ^ (uint8_t) buff[i]) * 1099511628211ULL;
+    return hash;
+}
+
+// Only MPPatch's files are cached, e.g. "mppatch_utils.lua" or the mppatch_patch_ soft hook injects. Precompiled
+// chunks start with an escape character, and are passed through as is.
+static bool isCacheable(const char* buff, size_t sz, const char* name) {
+    if(name == NULL || sz == 0 || buff[0] == '\033') return false;
+    if(*name == '@' || *name == '=') name++;
+    const char* file = name;
+    for(const char* c = name; *c; c++) if(*c == '/' || *c == '\\') file = c + 1;
+    return !strncmp(file, "mppatch_", 8);
+}
+
+static ChunkEntry* findEntry(uint64_t key, const char* name, size_t sz) {
+    for(int i=0; i<CHUNK_CACHE_MAX_ENTRIES; i++) {
+        ChunkEntry* entry = &entries[(key + i) % CHUNK_CACHE_MAX_ENTRIES];
+        if(entry->name == NULL) return entry;
+        if(entry->key == key && entry->sourceLength == sz && !strcmp(entry->name, name)) return entry;
+    }
+    return NULL;
+}
+
+typedef struct DumpBuffer {
+    char* data;
+    size_t length;
+    size_t capacity;
+} DumpBuffer;
+static int writeDump(lua_State *L, const void* p, size_t sz, void* ud) {
+    DumpBuffer* buffer = (DumpBuffer*) ud;
+    if(buffer->length + sz > buffer->capacity) {
+        size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+        while(capacity < buffer->length + sz) capacity *= 2;
+        char* data = realloc(buffer->data, capacity);
+        if(data == NULL) return 1;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, p, sz);
+    buffer->length += sz;
+    return 0;
+}
+
+ENTRY int ChunkCache_loadBuffer(lua_State *L, const char *buff, size_t sz, const char *name) {
+    if(!isCacheable(buff, sz, name)) {
+        Mutex_lock(&cacheLock);
+        cacheStats.uncached++;
+        Mutex_unlock(&cacheLock);
+        return ChunkCache_originalLoadBuffer(L, buff, sz, name);
+    }
+
+    uint64_t key = hashChunk(name, buff, sz);
+    Mutex_lock(&cacheLock);
+    ChunkEntry* entry = findEntry(key, name, sz);
+    bool isHit = entry != NULL && entry->name != NULL;
+    ChunkEntry hit = isHit ? *entry : (ChunkEntry) { 0 };
+    Mutex_unlock(&cacheLock);
+
+    // Cached bytecode is never freed while the process runs, so it can be used outside the lock.
+    uint64_t startTime = getMonotonicNanos();
+    if(isHit) {
+        int ret = ChunkCache_originalLoadBuffer(L, hit.bytecode, hit.bytecodeLength, name);
+        if(ret == 0) {
+            uint64_t elapsed = getMonotonicNanos() - startTime;
+            Mutex_lock(&cacheLock);
+            cacheStats.hits++;
+            cacheStats.loadNanos += elapsed;
+            if(hit.compileNanos > elapsed) cacheStats.savedNanos += hit.compileNanos - elapsed;
+            Mutex_unlock(&cacheLock);
+            return ret;
+        }
+        lua_pop(L, 1);
+        debug_warn("Cached bytecode for %s failed to load, compiling it from source.", name);
+        startTime = getMonotonicNanos();
+    }
+
+    int ret = ChunkCache_originalLoadBuffer(L, buff, sz, name);
+    uint64_t compileNanos = getMonotonicNanos() - startTime;
+    if(ret != 0 || isHit) return ret;
+
+    DumpBuffer dump = { NULL, 0, 0 };
+    bool isDumped = lua_dump(L, writeDump, &dump) == 0 && dump.length != 0;
+
+    Mutex_lock(&cacheLock);
+    cacheStats.misses++;
+    cacheStats.compileNanos += compileNanos;
+    entry = findEntry(key, name, sz);
+    bool hasRoom = cacheStats.entries < CHUNK_CACHE_MAX_ENTRIES * 3 / 4 &&
+                   cacheStats.bytes + dump.length <= CHUNK_CACHE_MAX_BYTES;
+    if(isDumped && entry != NULL && entry->name == NULL && hasRoom) {
+        *entry = (ChunkEntry) { key, strdup(name), sz, dump.data, dump.length, compileNanos };
+        cacheStats.entries++;
+        cacheStats.bytes += dump.length;
+        dump.data = NULL;
+    }
+    Mutex_unlock(&cacheLock);
+    free(dump.data);
+
+    return ret;
+}
+
+void ChunkCache_getStats(ChunkCacheStats* stats) {
+    Mutex_lock(&cacheLock);
+    *stats = cacheStats;
+    Mutex_unlock(&cacheLock);
+}
@@ -0,0 +1,51 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lua.h"
+
+// Caches the compiled bytecode of MPPatch's own Lua files, which every UI context loads again. Later loads of the same
+// file with the same contents load the cached bytecode instead of parsing the source.
+#define CHUNK_CACHE_MAX_ENTRIES 256
+#define CHUNK_CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+typedef struct ChunkCacheStats {
+    uint32_t entries;
+    uint32_t bytes;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t uncached;
+    uint64_t compileNanos;
+    uint64_t loadNanos;
+    uint64_t savedNanos;
+} ChunkCacheStats;
+
+typedef int (*luaL_loadbuffer_t)(lua_State *L, const char *buff, size_t sz, const char *name);
+extern luaL_loadbuffer_t ChunkCache_originalLoadBuffer;
+
+int ChunkCache_loadBuffer(lua_State *L, const char *buff, size_t sz, const char *name);
+
+void ChunkCache_getStats(ChunkCacheStats* stats);
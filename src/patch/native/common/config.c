@@ -31,6 +31,21 @@ bool enableLogging = false;
 bool enableDebug = false;
 bool enableMultiplayerPatch = false;
 bool enableLuaJIT = false;
+bool enableStartupProfileDump = false;
+bool enablePermanentNetHook = false;
+bool disableReloadSkip = false;
+bool enableTelemetry = false;
+bool enableFrameHitchDetector = false;
+int frameBudgetMillis = 50;
+bool enableLuaProfiler = false;
+bool enableSamplingProfiler = false;
+int samplingIntervalMillis = 10;
+bool enableJitDiagnostics = false;
+bool enableLuaAllocator = false;
+int gcUpdateBudgetMicros = 0;
+bool enableChunkCache = false;
+
+static int logLevel = -1;
 
 static int readConfig_handler(void* user, const char* section, const char* name, const char* value) {
     bool isFlagSet = strcmp(value, "true") == 0;
@@ -40,6 +55,20 @@ static int readConfig_handler(void* user, const char* section, const char* name,
     else if (CFG_MATCH("MPPatch", "enableDebug"           )) enableDebug            = isFlagSet;
     else if (CFG_MATCH("MPPatch", "enableMultiplayerPatch")) enableMultiplayerPatch = isFlagSet;
     else if (CFG_MATCH("MPPatch", "enableLuaJIT"          )) enableLuaJIT           = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enableStartupProfileDump")) enableStartupProfileDump = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enablePermanentNetHook")) enablePermanentNetHook = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "disableReloadSkip"     )) disableReloadSkip      = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enableTelemetry"       )) enableTelemetry        = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enableFrameHitchDetector")) enableFrameHitchDetector = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "frameBudgetMillis"     )) frameBudgetMillis      = atoi(value);
+    else if (CFG_MATCH("MPPatch", "enableLuaProfiler"     )) enableLuaProfiler      = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enableSamplingProfiler")) enableSamplingProfiler = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "samplingIntervalMillis")) samplingIntervalMillis = atoi(value);
+    else if (CFG_MATCH("MPPatch", "enableJitDiagnostics"  )) enableJitDiagnostics   = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "enableLuaAllocator"    )) enableLuaAllocator     = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "gcUpdateBudgetMicros"  )) gcUpdateBudgetMicros   = atoi(value);
+    else if (CFG_MATCH("MPPatch", "enableChunkCache"      )) enableChunkCache       = isFlagSet;
+    else if (CFG_MATCH("MPPatch", "logLevel"              )) logLevel               = debugLog_parseLevel(value);
     #undef CFG_MATCH
 
     return 1;
@@ -50,8 +79,24 @@ __attribute__((constructor(CONSTRUCTOR_READ_CONFIG))) static void readConfig() {
     getSupportFilePath(buffer, CONFIG_FILENAME);
     if(fileExists(buffer)) ini_parse(buffer, readConfig_handler, NULL);
 
+    if(logLevel != -1) debugLog_level = logLevel;
+    else if(!enableLogging) debugLog_level = LOG_LEVEL_WARN;
+    else debugLog_level = enableDebug ? LOG_LEVEL_TRACE : LOG_LEVEL_DEBUG;
+
     debug_print("enableLogging          = %s", enableLogging          ? "true" : "false")
     debug_print("enableDebug            = %s", enableDebug            ? "true" : "false")
     debug_print("enableMultiplayerPatch = %s", enableMultiplayerPatch ? "true" : "false")
     debug_print("enableLuaJIT           = %s", enableLuaJIT           ? "true" : "false")
+    debug_print("enablePermanentNetHook = %s", enablePermanentNetHook ? "true" : "false")
+    debug_print("disableReloadSkip      = %s", disableReloadSkip      ? "true" : "false")
+    debug_print("enableTelemetry        = %s", enableTelemetry        ? "true" : "false")
+    debug_print("enableFrameHitchDetector = %s (budget: %d ms)", enableFrameHitchDetector ? "true" : "false",
+                frameBudgetMillis)
+    debug_print("enableLuaProfiler      = %s", enableLuaProfiler      ? "true" : "false")
+    debug_print("enableSamplingProfiler = %s (interval: %d ms)", enableSamplingProfiler ? "true" : "false",
+                samplingIntervalMillis)
+    debug_print("enableJitDiagnostics   = %s", enableJitDiagnostics   ? "true" : "false")
+    debug_print("enableLuaAllocator     = %s", enableLuaAllocator     ? "true" : "false")
+    debug_print("gcUpdateBudgetMicros   = %d", gcUpdateBudgetMicros)
+    debug_print("enableChunkCache       = %s", enableChunkCache       ? "true" : "false")
 }
\ No newline at end of file
@@ -29,4 +29,17 @@
 extern bool enableLogging;
 extern bool enableDebug;
 extern bool enableMultiplayerPatch;
-extern bool enableLuaJIT;
\ No newline at end of file
+extern bool enableLuaJIT;
+extern bool enableStartupProfileDump;
+extern bool enablePermanentNetHook;
+extern bool disableReloadSkip;
+extern bool enableTelemetry;
+extern bool enableFrameHitchDetector;
+extern int frameBudgetMillis;
+extern bool enableLuaProfiler;
+extern bool enableSamplingProfiler;
+extern int samplingIntervalMillis;
+extern bool enableJitDiagnostics;
+extern bool enableLuaAllocator;
+extern int gcUpdateBudgetMicros;
+extern bool enableChunkCache;
\ No newline at end of file
@@ -0,0 +1,321 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Asynchronous debug logging.
+//
+// Call sites claim an entry in a fixed size lock-free ring, copy the timestamp, call site and message into it, and
+// return. A background thread formats the entries and writes them out in batches, so the game thread never waits on
+// stderr or on the log file. If the ring is full, the entry is dropped rather than blocking the caller, and the writer
+// reports how many entries were lost.
+//
+// Call sites are filtered by level before their arguments are evaluated (see debug_log in c_rt.h), and each call site
+// may only write DEBUG_LOG_RATE_LIMIT entries per DEBUG_LOG_RATE_WINDOW seconds, so hot paths cannot flood the log.
+//
+// When logging is disabled, only warnings and errors reach the ring, so no writer thread is started and call sites
+// write their entries out themselves.
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "c_rt.h"
+#include "debug_log.h"
+#include "platform.h"
+#include "config.h"
+
+#define DEBUG_LOG_ENTRIES        1024 // must be a power of two
+#define DEBUG_LOG_ENTRY_MASK     (DEBUG_LOG_ENTRIES - 1)
+#define DEBUG_LOG_MESSAGE_LENGTH 512
+#define DEBUG_LOG_BATCH_LENGTH   16384
+#define DEBUG_LOG_IDLE_MS        10
+#define DEBUG_LOG_SHUTDOWN_MS    100
+#define DEBUG_LOG_RATE_WINDOW    1
+#define DEBUG_LOG_RATE_LIMIT     200
+
+// Each entry carries a sequence number in the style of a bounded MPMC queue. It is stored offset by the entry's index,
+// so that the zero-initialized ring is already valid before any constructor has run.
+typedef struct DebugLogEntry {
+    uint32_t sequence;
+    time_t time;
+    const DebugLogCallSite* site;
+    uint32_t suppressed;
+    char message[DEBUG_LOG_MESSAGE_LENGTH];
+} DebugLogEntry;
+
+static DebugLogEntry logEntries[DEBUG_LOG_ENTRIES];
+static uint32_t enqueuePosition = 0;
+static uint32_t dequeuePosition = 0;
+static uint32_t droppedEntries  = 0;
+static uint32_t suppressedTotal = 0;
+
+static bool consumerLock   = false;
+static bool writeInline    = false;
+static bool writerShutdown = false;
+static bool writerExited   = false;
+
+FILE* debug_log_file = NULL;
+int debugLog_level = LOG_LEVEL_DEBUG; // lowered or raised once the configuration is read
+
+int debugLog_parseLevel(const char* name) {
+    if(!strcmp(name, "trace")) return LOG_LEVEL_TRACE;
+    if(!strcmp(name, "debug")) return LOG_LEVEL_DEBUG;
+    if(!strcmp(name, "info" )) return LOG_LEVEL_INFO ;
+    if(!strcmp(name, "warn" )) return LOG_LEVEL_WARN ;
+    if(!strcmp(name, "error")) return LOG_LEVEL_ERROR;
+    return -1;
+}
+
+static void drainInline();
+
+// Returns the number of entries suppressed since the call site last wrote, or -1 if this entry should be suppressed.
+static int64_t checkRateLimit(DebugLogCallSite* site, time_t now) {
+    uint32_t window = (uint32_t) now / DEBUG_LOG_RATE_WINDOW;
+    if(__atomic_load_n(&site->windowStart, __ATOMIC_RELAXED) != window) {
+        __atomic_store_n(&site->windowStart, window, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->windowCount, 0, __ATOMIC_RELAXED);
+    }
+    if(__atomic_add_fetch(&site->windowCount, 1, __ATOMIC_RELAXED) > DEBUG_LOG_RATE_LIMIT) {
+        __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&suppressedTotal, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+}
+
+void debugLog_write(DebugLogCallSite* site, const char* format, ...) {
+    time_t now = time(NULL);
+    int64_t suppressed = checkRateLimit(site, now);
+    if(suppressed < 0) return;
+
+    uint32_t position = __atomic_load_n(&enqueuePosition, __ATOMIC_RELAXED);
+    DebugLogEntry* entry;
+    while(true) {
+        entry = &logEntries[position & DEBUG_LOG_ENTRY_MASK];
+        uint32_t sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) + (position & DEBUG_LOG_ENTRY_MASK);
+        int32_t difference = (int32_t) (sequence - position);
+        if(difference == 0) {
+            if(__atomic_compare_exchange_n(&enqueuePosition, &position, position + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if(difference < 0) {
+            __atomic_fetch_add(&droppedEntries, 1, __ATOMIC_RELAXED);
+            return;
+        } else position = __atomic_load_n(&enqueuePosition, __ATOMIC_RELAXED);
+    }
+
+    entry->time       = now;
+    entry->site       = site;
+    entry->suppressed = (uint32_t) suppressed;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry->message, DEBUG_LOG_MESSAGE_LENGTH, format, args);
+    va_end(args);
+
+    __atomic_store_n(&entry->sequence, position + 1 - (position & DEBUG_LOG_ENTRY_MASK), __ATOMIC_RELEASE);
+    if(__atomic_load_n(&writeInline, __ATOMIC_ACQUIRE)) drainInline();
+}
+
+uint32_t debugLog_writtenEntries() {
+    return __atomic_load_n(&enqueuePosition, __ATOMIC_RELAXED);
+}
+uint32_t debugLog_droppedEntries() {
+    return __atomic_load_n(&droppedEntries, __ATOMIC_RELAXED);
+}
+uint32_t debugLog_suppressedEntries() {
+    return __atomic_load_n(&suppressedTotal, __ATOMIC_RELAXED);
+}
+
+// Writer side
+typedef struct DebugLogBatch {
+    char data[DEBUG_LOG_BATCH_LENGTH];
+    size_t length;
+} DebugLogBatch;
+
+static DebugLogBatch stderrBatch, fileBatch;
+static bool shouldWriteFile() {
+    return debug_log_file != NULL && enableLogging;
+}
+static void flushBatches() {
+    if(stderrBatch.length > 0) {
+        fwrite(stderrBatch.data, 1, stderrBatch.length, stderr);
+        stderrBatch.length = 0;
+    }
+    if(fileBatch.length > 0) {
+        if(shouldWriteFile()) {
+            fwrite(fileBatch.data, 1, fileBatch.length, debug_log_file);
+            fflush(debug_log_file);
+        }
+        fileBatch.length = 0;
+    }
+}
+static void appendLine(const char* line, size_t length) {
+    if(stderrBatch.length + length + 10 > DEBUG_LOG_BATCH_LENGTH || fileBatch.length + length > DEBUG_LOG_BATCH_LENGTH)
+        flushBatches();
+
+    memcpy(stderrBatch.data + stderrBatch.length, "[MPPatch] ", 10);
+    memcpy(stderrBatch.data + stderrBatch.length + 10, line, length);
+    stderrBatch.length += length + 10;
+
+    memcpy(fileBatch.data + fileBatch.length, line, length);
+    fileBatch.length += length;
+}
+
+static time_t lastTime = 0;
+static char lastTimeString[64];
+static const char* formatTime(time_t time_val) {
+    if(time_val != lastTime || !*lastTimeString) {
+        char* time_str_tmp = asctime(localtime(&time_val));
+        strncpy(lastTimeString, time_str_tmp, sizeof(lastTimeString));
+        lastTimeString[sizeof(lastTimeString) - 1] = '\0';
+        lastTimeString[strcspn(lastTimeString, "\n")] = '\0';
+        lastTime = time_val;
+    }
+    return lastTimeString;
+}
+
+static uint32_t reportedDrops = 0;
+static void formatEntry(DebugLogEntry* entry) {
+    char line[DEBUG_LOG_MESSAGE_LENGTH + 256];
+    int length;
+
+    const DebugLogCallSite* site = entry->site;
+    if(!site->raw) {
+        const char* file = strrchr(site->file, '/');
+        length = snprintf(line, sizeof(line), "[%s] %s at %s:%u - %s\n", formatTime(entry->time), site->function,
+                          file ? file + 1 : site->file, site->line, entry->message);
+    } else length = snprintf(line, sizeof(line), "[%s] %s\n", formatTime(entry->time), entry->message);
+
+    if(length < 0) return;
+    if(length >= sizeof(line)) {
+        length = sizeof(line) - 1;
+        line[length - 1] = '\n';
+    }
+    if(entry->suppressed > 0) {
+        char* end = line + length - 1;
+        int extra = snprintf(end, sizeof(line) - (length - 1), " <%u similar entries suppressed>\n", entry->suppressed);
+        if(extra > 0 && length - 1 + extra < sizeof(line)) length += extra - 1;
+        else line[length - 1] = '\n';
+    }
+    appendLine(line, length);
+}
+static void reportDrops() {
+    uint32_t drops = debugLog_droppedEntries();
+    if(drops != reportedDrops) {
+        char line[128];
+        int length = snprintf(line, sizeof(line), "[%s] <%u log entries dropped>\n", formatTime(time(NULL)),
+                              drops - reportedDrops);
+        reportedDrops = drops;
+        if(length > 0 && length < sizeof(line)) appendLine(line, length);
+    }
+}
+
+static bool isEntryReady(DebugLogEntry* entry) {
+    uint32_t position = __atomic_load_n(&dequeuePosition, __ATOMIC_RELAXED);
+    uint32_t sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) + (position & DEBUG_LOG_ENTRY_MASK);
+    return (int32_t) (sequence - (position + 1)) >= 0;
+}
+
+// Only one thread may consume entries at a time. Returns the number of entries written.
+static int drainEntries() {
+    int count = 0;
+    while(true) {
+        DebugLogEntry* entry = &logEntries[dequeuePosition & DEBUG_LOG_ENTRY_MASK];
+        if(!isEntryReady(entry)) break;
+
+        formatEntry(entry);
+        __atomic_store_n(&entry->sequence,
+                         dequeuePosition + DEBUG_LOG_ENTRIES - (dequeuePosition & DEBUG_LOG_ENTRY_MASK),
+                         __ATOMIC_RELEASE);
+        dequeuePosition++;
+        count++;
+    }
+    reportDrops();
+    flushBatches();
+    return count;
+}
+
+static bool tryLockConsumer() {
+    return !__sync_lock_test_and_set(&consumerLock, true);
+}
+static void unlockConsumer() {
+    __sync_lock_release(&consumerLock);
+}
+
+void debugLog_flush() {
+    // If the writer thread is stuck holding the lock (e.g. it was killed during process exit), the last entries are
+    // lost, as draining without the lock would race with its batches.
+    for(int i = 0; i < DEBUG_LOG_SHUTDOWN_MS; i++) {
+        if(tryLockConsumer()) {
+            drainEntries();
+            unlockConsumer();
+            return;
+        }
+        sleepMilliseconds(1);
+    }
+}
+
+// Another thread may be draining when an entry is published. Whichever of the two sees the other last writes it out:
+// the publisher takes the lock, or the drainer finds the entry after releasing it.
+static void drainInline() {
+    while(tryLockConsumer()) {
+        drainEntries();
+        unlockConsumer();
+        __sync_synchronize();
+        if(!isEntryReady(&logEntries[__atomic_load_n(&dequeuePosition, __ATOMIC_RELAXED) & DEBUG_LOG_ENTRY_MASK]))
+            break;
+    }
+}
+
+static void debugLogWriter(void* unused) {
+    while(!__atomic_load_n(&writerShutdown, __ATOMIC_ACQUIRE)) {
+        int written = 0;
+        if(tryLockConsumer()) {
+            written = drainEntries();
+            unlockConsumer();
+        }
+        if(written == 0) sleepMilliseconds(DEBUG_LOG_IDLE_MS);
+    }
+    __atomic_store_n(&writerExited, true, __ATOMIC_RELEASE);
+}
+
+__attribute__((constructor(CONSTRUCTOR_LOGGING))) static void initDebugLogging() {
+    char buffer[PATH_MAX];
+    getSupportFilePath(buffer, "mppatch_debug.log");
+    if(enableLogging) debug_log_file = fopen(buffer, "w");
+
+    if(enableLogging) startThread(debugLogWriter, NULL);
+    else {
+        __atomic_store_n(&writeInline, true, __ATOMIC_RELEASE);
+        __sync_synchronize();
+        drainInline();
+    }
+}
+__attribute__((destructor)) static void shutdownDebugLogging() {
+    if(!writeInline) {
+        __atomic_store_n(&writerShutdown, true, __ATOMIC_RELEASE);
+        for(int i = 0; i < DEBUG_LOG_SHUTDOWN_MS && !__atomic_load_n(&writerExited, __ATOMIC_ACQUIRE); i++)
+            sleepMilliseconds(1);
+    }
+    debugLog_flush();
+}
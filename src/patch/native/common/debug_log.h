@@ -0,0 +1,61 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+
+// Call sites below this level are compiled out entirely. The build scripts set this for release builds.
+#ifndef MPPATCH_MIN_LOG_LEVEL
+    #define MPPATCH_MIN_LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+
+// Identifies a debug_print call site. Instances are static, so the log ring only needs to store a pointer. The
+// remaining fields track the call site's rate limit.
+typedef struct DebugLogCallSite {
+    const char* function;
+    const char* file;
+    unsigned int line;
+    bool raw;
+
+    uint32_t windowStart;
+    uint32_t windowCount;
+    uint32_t suppressed;
+} DebugLogCallSite;
+
+extern int debugLog_level;
+#define debugLog_isEnabled(level) ((level) >= MPPATCH_MIN_LOG_LEVEL && (level) >= debugLog_level)
+
+void debugLog_write(DebugLogCallSite* site, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void debugLog_flush();
+
+int debugLog_parseLevel(const char* name);
+uint32_t debugLog_writtenEntries();
+uint32_t debugLog_droppedEntries();
+uint32_t debugLog_suppressedEntries();
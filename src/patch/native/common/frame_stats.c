@@ -0,0 +1,115 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "config.h"
+#include "platform.h"
+#include "sync.h"
+#include "frame_stats.h"
+
+// Work done during the current frame. Hooks may run on other threads than the one presenting frames, so these are
+// updated with relaxed atomics, and taken with an exchange at the end of each frame.
+static uint64_t frameHookNanos[HOOK_METRIC_COUNT];
+static uint32_t frameHookCalls[HOOK_METRIC_COUNT];
+
+static uint64_t lastFrameTime = 0;
+static uint32_t lastLogPosition = 0;
+
+static FrameStats stats;
+static FrameIncident incidents[FRAME_INCIDENT_COUNT];
+static uint32_t incidentCount = 0;
+static Mutex statsLock = MUTEX_INITIALIZER;
+
+void FrameStats_chargeHook(HookMetric metric, uint64_t nanos) {
+    if(!enableFrameHitchDetector) return;
+    __atomic_fetch_add(&frameHookNanos[metric], nanos, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&frameHookCalls[metric], 1, __ATOMIC_RELAXED);
+}
+
+static void logIncident(const FrameIncident* incident) {
+    const double ms = 1000000.0;
+    uint64_t netHookNanos = incident->hookNanos[HOOK_METRIC_SETACTIVEDLCANDMODS];
+    uint64_t originalNanos = incident->hookNanos[HOOK_METRIC_SETACTIVEDLCANDMODS_ORIGINAL];
+    debug_warn("Frame %u took %.1f ms: lGetMemoryUsage %.2f ms in %u calls, SetActiveDLCAndMods %.2f ms in %u calls "
+               "(%.2f ms in the game), %u log entries.",
+               incident->frame, incident->intervalNanos / ms,
+               incident->hookNanos[HOOK_METRIC_LGETMEMORYUSAGE] / ms,
+               incident->hookCalls[HOOK_METRIC_LGETMEMORYUSAGE],
+               netHookNanos / ms, incident->hookCalls[HOOK_METRIC_SETACTIVEDLCANDMODS], originalNanos / ms,
+               incident->logEntries);
+}
+
+void FrameStats_endFrame() {
+    uint64_t now = getMonotonicNanos();
+    uint32_t logPosition = debugLog_writtenEntries();
+
+    FrameIncident frame;
+    for(int i=0; i<HOOK_METRIC_COUNT; i++) {
+        frame.hookNanos[i] = __atomic_exchange_n(&frameHookNanos[i], 0, __ATOMIC_RELAXED);
+        frame.hookCalls[i] = __atomic_exchange_n(&frameHookCalls[i], 0, __ATOMIC_RELAXED);
+    }
+    frame.logEntries    = logPosition - lastLogPosition;
+    frame.intervalNanos = now - lastFrameTime;
+
+    bool isFirstFrame = lastFrameTime == 0;
+    lastFrameTime   = now;
+    lastLogPosition = logPosition;
+    if(isFirstFrame) return;
+
+    uint32_t millis = frame.intervalNanos / 1000000 > UINT32_MAX ? UINT32_MAX : frame.intervalNanos / 1000000;
+    int bucket = millis == 0 ? 0 : 32 - __builtin_clz(millis);
+    if(bucket >= FRAME_HISTOGRAM_BUCKETS) bucket = FRAME_HISTOGRAM_BUCKETS - 1;
+
+    Mutex_lock(&statsLock);
+    frame.frame = stats.frames++;
+    stats.histogram[bucket]++;
+    bool isHitch = frame.intervalNanos > stats.budgetNanos;
+    if(isHitch) {
+        stats.hitches++;
+        incidents[incidentCount++ % FRAME_INCIDENT_COUNT] = frame;
+    }
+    Mutex_unlock(&statsLock);
+
+    if(isHitch) logIncident(&frame);
+}
+
+void FrameStats_get(FrameStats* out) {
+    Mutex_lock(&statsLock);
+    *out = stats;
+    Mutex_unlock(&statsLock);
+}
+int FrameStats_getIncidents(FrameIncident* out, int max) {
+    Mutex_lock(&statsLock);
+    int count = incidentCount < FRAME_INCIDENT_COUNT ? incidentCount : FRAME_INCIDENT_COUNT;
+    if(count > max) count = max;
+    for(int i=0; i<count; i++)
+        out[i] = incidents[(incidentCount - count + i) % FRAME_INCIDENT_COUNT];
+    Mutex_unlock(&statsLock);
+    return count;
+}
+
+__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void initFrameStats() {
+    stats.budgetNanos = (uint64_t) frameBudgetMillis * 1000000;
+}
@@ -0,0 +1,57 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "metrics.h"
+
+// Frame hitch detection. The platform calls FrameStats_endFrame once per presented frame, and MPPatch's own work is
+// charged to the frame it ran in. Frames that exceed frameBudgetMillis are recorded as incidents, so lobby stutter
+// can be attributed either to MPPatch or to the game.
+//
+// Histogram bucket 0 counts frames under 1 ms, and bucket n counts frames taking [2^(n-1), 2^n) ms.
+#define FRAME_HISTOGRAM_BUCKETS 16
+#define FRAME_INCIDENT_COUNT    32
+
+typedef struct FrameIncident {
+    uint32_t frame;
+    uint64_t intervalNanos;
+    uint64_t hookNanos[HOOK_METRIC_COUNT];
+    uint32_t hookCalls[HOOK_METRIC_COUNT];
+    uint32_t logEntries;
+} FrameIncident;
+
+typedef struct FrameStats {
+    uint32_t frames;
+    uint32_t hitches;
+    uint64_t budgetNanos;
+    uint32_t histogram[FRAME_HISTOGRAM_BUCKETS];
+} FrameStats;
+
+void FrameStats_chargeHook(HookMetric metric, uint64_t nanos);
+void FrameStats_endFrame();
+
+void FrameStats_get(FrameStats* out);
+// Copies up to max incidents, oldest first, and returns how many were copied.
+int FrameStats_getIncidents(FrameIncident* out, int max);
@@ -0,0 +1,228 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "sync.h"
+#include "gc_pacer.h"
+
+#include "lua.h"
+
+// Pacing state is kept per Lua VM in the registry:
+//   reasons  - active deferral reasons, mapped to true or to the GcPacer_Condition that ends them
+//   deferred - number of active deferral reasons
+//   waiting  - number of active deferral reasons with a condition
+//   stepping - whether budgeted steps have been run in this state
+//   stopped  - whether the automatic collector was stopped for the current deferral
+//   resumeKB - memory use at which budgeted stepping resumes after a finished cycle
+//   pause    - the pause ratio last set through GcPacer_setPause
+#define GcPacer_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_gcpacer"
+
+static GcStats gcStats;
+static Mutex statsLock = MUTEX_INITIALIZER;
+
+static void pushPacerState(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, GcPacer_REGINDEX);
+    if(lua_type(L, -1) == LUA_TTABLE) return;
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 4);
+    lua_createtable(L, 0, 0);
+    lua_setfield(L, -2, "reasons");
+    lua_pushinteger(L, GC_PACER_DEFAULT_PAUSE);
+    lua_setfield(L, -2, "pause");
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, GcPacer_REGINDEX);
+}
+static lua_Integer getStateField(lua_State *L, const char* field) {
+    pushPacerState(L);
+    lua_getfield(L, -1, field);
+    lua_Integer value = lua_tointeger(L, -1);
+    lua_pop(L, 2);
+    return value;
+}
+static void setStateField(lua_State *L, const char* field, lua_Integer value) {
+    pushPacerState(L);
+    lua_pushinteger(L, value);
+    lua_setfield(L, -2, field);
+    lua_pop(L, 1);
+}
+
+// Resumes every reason whose condition no longer holds.
+static void expireReasons(lua_State *L) {
+    if(getStateField(L, "waiting") == 0) return;
+
+    char expired[64];
+    do {
+        expired[0] = '\0';
+        pushPacerState(L);
+        lua_getfield(L, -1, "reasons");
+        lua_pushnil(L);
+        while(lua_next(L, -2)) {
+            if(lua_type(L, -1) == LUA_TLIGHTUSERDATA && !((GcPacer_Condition) lua_touserdata(L, -1))()) {
+                snprintf(expired, sizeof(expired), "%s", lua_tostring(L, -2));
+                lua_pop(L, 2);
+                break;
+            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 2);
+        if(expired[0] != '\0') GcPacer_resume(L, expired);
+    } while(expired[0] != '\0');
+}
+
+bool GcPacer_step(lua_State *L, uint64_t budgetNanos, int stepKB) {
+    expireReasons(L);
+    setStateField(L, "stepping", 1);
+
+    int memoryKB = lua_gc(L, LUA_GCCOUNT, 0);
+    if(memoryKB < getStateField(L, "resumeKB")) {
+        Mutex_lock(&statsLock);
+        gcStats.skippedSteps++;
+        Mutex_unlock(&statsLock);
+        return false;
+    }
+
+    uint64_t startTime = getMonotonicNanos(), elapsed = 0;
+    uint32_t steps = 0;
+    bool finished = false;
+    while(!finished && elapsed < budgetNanos) {
+        finished = lua_gc(L, LUA_GCSTEP, stepKB) != 0;
+        steps++;
+        elapsed = getMonotonicNanos() - startTime;
+    }
+
+    // LUA_GCSTEP rearms the automatic collector, so it must be stopped again.
+    if(getStateField(L, "stopped")) lua_gc(L, LUA_GCSTOP, 0);
+    if(finished) setStateField(L, "resumeKB", (lua_Integer) lua_gc(L, LUA_GCCOUNT, 0) * getStateField(L, "pause") / 100);
+
+    Mutex_lock(&statsLock);
+    gcStats.stepCalls++;
+    gcStats.steps += steps;
+    gcStats.stepNanos += elapsed;
+    if(elapsed > gcStats.maxStepNanos) gcStats.maxStepNanos = elapsed;
+    if(finished) gcStats.cycles++;
+    Mutex_unlock(&statsLock);
+    return finished;
+}
+bool GcPacer_collect(lua_State *L) {
+    expireReasons(L);
+    if(getStateField(L, "deferred") > 0) {
+        Mutex_lock(&statsLock);
+        gcStats.deferredCollections++;
+        Mutex_unlock(&statsLock);
+        return false;
+    }
+
+    uint64_t startTime = getMonotonicNanos();
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    uint64_t elapsed = getMonotonicNanos() - startTime;
+    setStateField(L, "resumeKB", (lua_Integer) lua_gc(L, LUA_GCCOUNT, 0) * getStateField(L, "pause") / 100);
+
+    Mutex_lock(&statsLock);
+    gcStats.fullCollections++;
+    gcStats.fullCollectionNanos += elapsed;
+    Mutex_unlock(&statsLock);
+    return true;
+}
+
+void GcPacer_deferWhile(lua_State *L, const char* reason, GcPacer_Condition condition, bool stopCollector) {
+    pushPacerState(L);
+    lua_getfield(L, -1, "reasons");
+    lua_getfield(L, -1, reason);
+    bool isActive = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    if(!isActive) {
+        if(condition != NULL) {
+            lua_pushlightuserdata(L, (void*) condition);
+            setStateField(L, "waiting", getStateField(L, "waiting") + 1);
+        } else lua_pushboolean(L, 1);
+        lua_setfield(L, -2, reason);
+        lua_Integer deferred = getStateField(L, "deferred") + 1;
+        setStateField(L, "deferred", deferred);
+        if(stopCollector && getStateField(L, "stepping") && !getStateField(L, "stopped")) {
+            setStateField(L, "stopped", 1);
+            lua_gc(L, LUA_GCSTOP, 0);
+        }
+        debug_print("Deferring garbage collection for %s.", reason);
+    }
+    lua_pop(L, 2);
+}
+void GcPacer_defer(lua_State *L, const char* reason, bool stopCollector) {
+    GcPacer_deferWhile(L, reason, NULL, stopCollector);
+}
+void GcPacer_resume(lua_State *L, const char* reason) {
+    pushPacerState(L);
+    lua_getfield(L, -1, "reasons");
+    lua_getfield(L, -1, reason);
+    bool isActive = lua_toboolean(L, -1);
+    bool isWaiting = lua_type(L, -1) == LUA_TLIGHTUSERDATA;
+    lua_pop(L, 1);
+    if(isActive) {
+        if(isWaiting) setStateField(L, "waiting", getStateField(L, "waiting") - 1);
+        lua_pushnil(L);
+        lua_setfield(L, -2, reason);
+        lua_Integer deferred = getStateField(L, "deferred") - 1;
+        setStateField(L, "deferred", deferred);
+        if(deferred == 0 && getStateField(L, "stopped")) {
+            setStateField(L, "stopped", 0);
+            lua_gc(L, LUA_GCRESTART, 0);
+        }
+        debug_print("Resuming garbage collection for %s.", reason);
+    }
+    lua_pop(L, 2);
+}
+int GcPacer_deferrals(lua_State *L) {
+    expireReasons(L);
+    return getStateField(L, "deferred");
+}
+bool GcPacer_isDeferred(lua_State *L, const char* reason) {
+    expireReasons(L);
+    pushPacerState(L);
+    lua_getfield(L, -1, "reasons");
+    lua_getfield(L, -1, reason);
+    bool isActive = lua_toboolean(L, -1);
+    lua_pop(L, 3);
+    return isActive;
+}
+
+int GcPacer_setPause(lua_State *L, int pause) {
+    setStateField(L, "pause", pause);
+    return lua_gc(L, LUA_GCSETPAUSE, pause);
+}
+int GcPacer_setStepMul(lua_State *L, int stepMul) {
+    return lua_gc(L, LUA_GCSETSTEPMUL, stepMul);
+}
+
+void GcPacer_getStats(GcStats* stats) {
+    Mutex_lock(&statsLock);
+    *stats = gcStats;
+    Mutex_unlock(&statsLock);
+}
+void GcPacer_resetStats() {
+    Mutex_lock(&statsLock);
+    memset(&gcStats, 0, sizeof(GcStats));
+    Mutex_unlock(&statsLock);
+}
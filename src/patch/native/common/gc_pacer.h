@@ -0,0 +1,68 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lua.h"
+
+// Lets UI scripts pace the garbage collector: incremental work is done in time-budgeted slices, usually once per
+// update, and full collections are held off while something timing sensitive such as a launch countdown is running.
+#define GC_PACER_DEFAULT_PAUSE 200
+
+typedef struct GcStats {
+    uint32_t stepCalls;
+    uint32_t steps;
+    uint32_t skippedSteps;
+    uint32_t cycles;
+    uint64_t stepNanos;
+    uint64_t maxStepNanos;
+    uint32_t fullCollections;
+    uint64_t fullCollectionNanos;
+    uint32_t deferredCollections;
+} GcStats;
+
+// Runs incremental steps until budgetNanos elapse or a collection cycle finishes. After a cycle, steps are skipped
+// until memory grows by the pause ratio again. Returns true if a cycle finished.
+bool GcPacer_step(lua_State *L, uint64_t budgetNanos, int stepKB);
+// Runs a full collection, unless collections are deferred. Returns false if the collection was deferred.
+bool GcPacer_collect(lua_State *L);
+
+// Defers full collections until every reason has been resumed. If stopCollector is set and the state has run budgeted
+// steps before, the automatic collector is also stopped, leaving budgeted steps as the only collection work.
+void GcPacer_defer(lua_State *L, const char* reason, bool stopCollector);
+// Like GcPacer_defer, but the reason is also resumed once condition returns false. This is checked whenever the pacer
+// is next used from the same state, so a deferral can end on something that happens outside of Lua.
+typedef bool (*GcPacer_Condition)();
+void GcPacer_deferWhile(lua_State *L, const char* reason, GcPacer_Condition condition, bool stopCollector);
+void GcPacer_resume(lua_State *L, const char* reason);
+int GcPacer_deferrals(lua_State *L);
+bool GcPacer_isDeferred(lua_State *L, const char* reason);
+
+// Both return the previous value.
+int GcPacer_setPause(lua_State *L, int pause);
+int GcPacer_setStepMul(lua_State *L, int stepMul);
+
+void GcPacer_getStats(GcStats* stats);
+void GcPacer_resetStats();
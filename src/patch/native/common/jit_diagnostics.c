@@ -0,0 +1,417 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "sync.h"
+#include "jit_diagnostics.h"
+
+#include "lua.h"
+
+#define JitDiagnostics_TRACES_REGINDEX  "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_jittraces"
+#define JitDiagnostics_HANDLER_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_jithandler"
+
+// Trace numbers are reused after a flush, and are small enough that a direct mapped table is enough to remember where
+// a trace started until it completes or aborts.
+#define MAX_TRACES 4096
+typedef struct TraceStart {
+    int trace;
+    int location;
+    int pc;
+    int op;
+} TraceStart;
+
+typedef struct LocationEntry {
+    uint32_t hash;
+    bool used;
+    JitTraceLocation data;
+} LocationEntry;
+typedef struct ReasonEntry {
+    uint32_t hash;
+    bool used;
+    JitAbortReason data;
+} ReasonEntry;
+
+static TraceStart traces[MAX_TRACES];
+static LocationEntry locations[JIT_DIAGNOSTICS_MAX_LOCATIONS];
+static ReasonEntry reasons[JIT_DIAGNOSTICS_MAX_REASONS];
+static int locationCount, reasonCount;
+static uint32_t droppedEvents;
+static Mutex diagnosticsLock = MUTEX_INITIALIZER;
+
+static uint32_t hashName(const char* name) {
+    uint32_t hash = 2166136261U;
+    for(const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619U;
+    return hash;
+}
+#define DEFINE_FIND(fn, Entry, table, size, count, field) \
+    static int fn(const char* name) { \
+        uint32_t hash = hashName(name); \
+        for(uint32_t i=0; i<size; i++) { \
+            int index = (hash + i) % size; \
+            Entry* entry = &table[index]; \
+            if(!entry->used) { \
+                if(count >= size * 3 / 4) return -1; \
+                entry->used = true; \
+                entry->hash = hash; \
+                snprintf(entry->data.field, JIT_DIAGNOSTICS_NAME_LENGTH, "%s", name); \
+                count++; \
+                return index; \
+            } \
+            if(entry->hash == hash && !strncmp(entry->data.field, name, JIT_DIAGNOSTICS_NAME_LENGTH - 1)) \
+                return index; \
+        } \
+        return -1; \
+    }
+DEFINE_FIND(findLocation, LocationEntry, locations, JIT_DIAGNOSTICS_MAX_LOCATIONS, locationCount, location)
+DEFINE_FIND(findReason  , ReasonEntry  , reasons  , JIT_DIAGNOSTICS_MAX_REASONS  , reasonCount  , reason  )
+#undef DEFINE_FIND
+
+// Module lookup
+//
+// jit.util is preloaded by LuaJIT but usually never required, and the game's UI environments have no require, so
+// modules are looked up in the registry directly.
+static bool pushModule(lua_State *L, const char* name) {
+    lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+    lua_getfield(L, -1, name);
+    if(lua_type(L, -1) == LUA_TTABLE) {
+        lua_remove(L, -2);
+        return true;
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, "_PRELOAD");
+    lua_getfield(L, -1, name);
+    lua_remove(L, -2);
+    if(lua_type(L, -1) != LUA_TFUNCTION) {
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "_G");
+        lua_getfield(L, -1, "require");
+        lua_remove(L, -2);
+        if(lua_type(L, -1) != LUA_TFUNCTION) {
+            lua_pop(L, 2);
+            return false;
+        }
+    }
+    lua_pushstring(L, name);
+    if(lua_pcall(L, 1, 1, 0) != 0 || lua_type(L, -1) != LUA_TTABLE) {
+        lua_pop(L, 2);
+        return false;
+    }
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -3, name);
+    lua_remove(L, -2);
+    return true;
+}
+
+// Abort reason names come from jit.vmdef when it can be loaded, as the error numbers differ between LuaJIT versions.
+static char* traceErrors[JIT_DIAGNOSTICS_MAX_REASONS];
+static void loadTraceErrors(lua_State *L) {
+    if(!pushModule(L, "jit.vmdef")) {
+        debug_print("jit.vmdef is not available, trace abort reasons will be reported by number.");
+        return;
+    }
+    lua_getfield(L, -1, "traceerr");
+    if(lua_type(L, -1) == LUA_TTABLE) {
+        Mutex_lock(&diagnosticsLock);
+        for(int i=0; i<JIT_DIAGNOSTICS_MAX_REASONS; i++) {
+            lua_rawgeti(L, -1, i);
+            if(lua_type(L, -1) == LUA_TSTRING && traceErrors[i] == NULL) traceErrors[i] = strdup(lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+        Mutex_unlock(&diagnosticsLock);
+    }
+    lua_pop(L, 2);
+}
+static void formatReason(char* buffer, size_t size, int code, const char* info) {
+    const char* format = code >= 0 && code < JIT_DIAGNOSTICS_MAX_REASONS ? traceErrors[code] : NULL;
+    if(format == NULL) {
+        snprintf(buffer, size, *info ? "trace error %d (%s)" : "trace error %d", code, info);
+        return;
+    }
+
+    // traceerr entries contain at most one %s or %d, which is filled in with the already formatted info.
+    const char* arg = strchr(format, '%');
+    if(arg == NULL || (arg[1] != 's' && arg[1] != 'd')) snprintf(buffer, size, "%s", format);
+    else snprintf(buffer, size, "%.*s%s%s", (int) (arg - format), format, info, arg + 2);
+}
+
+// Event handling
+static void locate(lua_State *L, int util, int func, int pc, char* buffer, size_t size) {
+    lua_getfield(L, util, "funcinfo");
+    lua_pushvalue(L, func);
+    lua_pushinteger(L, pc);
+    lua_call(L, 2, 1);
+    lua_getfield(L, -1, "source");
+    lua_getfield(L, -2, "currentline");
+    const char* source = lua_type(L, -2) == LUA_TSTRING ? lua_tostring(L, -2) : "[C]";
+    if(*source == '@' || *source == '=') source++;
+    const char* file = strrchr(source, '/');
+    const char* backslash = strrchr(file ? file : source, '\\');
+    if(backslash) file = backslash;
+    snprintf(buffer, size, "%s:%d", file ? file + 1 : source, (int) lua_tointeger(L, -1));
+    lua_pop(L, 3);
+}
+static int bytecodeOp(lua_State *L, int util, int func, int pc) {
+    lua_getfield(L, util, "funcbc");
+    lua_pushvalue(L, func);
+    lua_pushinteger(L, pc);
+    lua_call(L, 2, 1);
+    int op = lua_type(L, -1) == LUA_TNUMBER ? (int) lua_tointeger(L, -1) & 0xFF : -1;
+    lua_pop(L, 1);
+    return op;
+}
+static void formatInfo(lua_State *L, int util, int info, char* buffer, size_t size) {
+    switch(lua_type(L, info)) {
+        case LUA_TNUMBER:
+        case LUA_TSTRING:
+            snprintf(buffer, size, "%s", lua_tostring(L, info));
+            break;
+        case LUA_TFUNCTION:
+            lua_getfield(L, util, "funcinfo");
+            lua_pushvalue(L, info);
+            lua_call(L, 1, 1);
+            lua_getfield(L, -1, "ffid");
+            if(lua_type(L, -1) == LUA_TNUMBER) snprintf(buffer, size, "builtin#%d", (int) lua_tointeger(L, -1));
+            else locate(L, util, info, 0, buffer, size);
+            lua_pop(L, 2);
+            break;
+        default:
+            *buffer = '\0';
+    }
+}
+
+// The start function of each trace is kept alive in the registry, so its bytecode can be checked for blacklisting on
+// abort.
+static void pushTraceTable(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, JitDiagnostics_TRACES_REGINDEX);
+    if(lua_type(L, -1) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 0);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, JitDiagnostics_TRACES_REGINDEX);
+    }
+}
+
+static void onStart(lua_State *L, int util, int trace) {
+    char location[JIT_DIAGNOSTICS_NAME_LENGTH];
+    locate(L, util, 3, lua_tointeger(L, 4), location, sizeof(location));
+    int op = bytecodeOp(L, util, 3, lua_tointeger(L, 4));
+
+    pushTraceTable(L);
+    lua_pushvalue(L, 3);
+    lua_rawseti(L, -2, trace);
+    lua_pop(L, 1);
+
+    Mutex_lock(&diagnosticsLock);
+    int index = findLocation(location);
+    if(index == -1) droppedEvents++;
+    else locations[index].data.started++;
+    traces[trace % MAX_TRACES] = (TraceStart) { trace, index, lua_tointeger(L, 4), op };
+    Mutex_unlock(&diagnosticsLock);
+}
+static TraceStart takeTrace(int trace) {
+    TraceStart start = { -1, -1, 0, -1 };
+    Mutex_lock(&diagnosticsLock);
+    if(traces[trace % MAX_TRACES].trace == trace) {
+        start = traces[trace % MAX_TRACES];
+        traces[trace % MAX_TRACES].trace = -1;
+    }
+    Mutex_unlock(&diagnosticsLock);
+    return start;
+}
+static void onStop(lua_State *L, int trace) {
+    TraceStart start = takeTrace(trace);
+    pushTraceTable(L);
+    lua_pushnil(L);
+    lua_rawseti(L, -2, trace);
+    lua_pop(L, 1);
+
+    Mutex_lock(&diagnosticsLock);
+    if(start.location != -1) locations[start.location].data.completed++;
+    Mutex_unlock(&diagnosticsLock);
+}
+static void onAbort(lua_State *L, int util, int trace) {
+    TraceStart start = takeTrace(trace);
+
+    // LuaJIT penalizes the starting bytecode before sending the abort event. Once it is blacklisted, the bytecode is
+    // replaced with its interpreter only variant, so a changed opcode means the location will never be traced again.
+    bool blacklisted = false;
+    pushTraceTable(L);
+    int table = lua_gettop(L);
+    lua_rawgeti(L, table, trace);
+    if(start.trace != -1 && lua_type(L, -1) == LUA_TFUNCTION)
+        blacklisted = bytecodeOp(L, util, lua_gettop(L), start.pc) != start.op;
+    lua_pushnil(L);
+    lua_rawseti(L, table, trace);
+
+    char info[JIT_DIAGNOSTICS_NAME_LENGTH], reason[JIT_DIAGNOSTICS_NAME_LENGTH];
+    formatInfo(L, util, 6, info, sizeof(info));
+    int code = lua_tointeger(L, 5);
+
+    Mutex_lock(&diagnosticsLock);
+    formatReason(reason, sizeof(reason), code, info);
+    int reasonIndex = findReason(reason);
+    if(reasonIndex == -1) droppedEvents++;
+    else reasons[reasonIndex].data.count++;
+
+    if(start.location != -1) {
+        JitTraceLocation* location = &locations[start.location].data;
+        location->aborted++;
+        strcpy(location->lastReason, reason);
+        if(blacklisted) location->blacklisted++;
+    }
+    Mutex_unlock(&diagnosticsLock);
+}
+static void onFlush() {
+    Mutex_lock(&diagnosticsLock);
+    for(int i=0; i<MAX_TRACES; i++) traces[i].trace = -1;
+    Mutex_unlock(&diagnosticsLock);
+}
+
+// Called by LuaJIT as (what, tr, func, pc, otr/code, oex/info).
+static int JitDiagnostics_traceEvent(lua_State *L) {
+    int top = lua_gettop(L);
+    lua_settop(L, 6);
+    if(!pushModule(L, "jit.util")) {
+        lua_settop(L, top);
+        return 0;
+    }
+    int util = lua_gettop(L);
+
+    const char* what = lua_type(L, 1) == LUA_TSTRING ? lua_tostring(L, 1) : "";
+    int trace = lua_tointeger(L, 2);
+         if(!strcmp(what, "start")) onStart(L, util, trace);
+    else if(!strcmp(what, "stop" )) onStop(L, trace);
+    else if(!strcmp(what, "abort")) onAbort(L, util, trace);
+    else if(!strcmp(what, "flush")) {
+        onFlush();
+        lua_pushnil(L);
+        lua_setfield(L, LUA_REGISTRYINDEX, JitDiagnostics_TRACES_REGINDEX);
+    }
+
+    lua_settop(L, top);
+    return 0;
+}
+
+static bool callAttach(lua_State *L, bool attach) {
+    if(!pushModule(L, "jit")) return false;
+    lua_getfield(L, -1, "attach");
+    lua_remove(L, -2);
+    if(lua_type(L, -1) != LUA_TFUNCTION) {
+        lua_pop(L, 1);
+        return false;
+    }
+    // jit.attach identifies handlers by identity, so the same closure is used to attach and detach.
+    lua_getfield(L, LUA_REGISTRYINDEX, JitDiagnostics_HANDLER_REGINDEX);
+    if(lua_type(L, -1) != LUA_TFUNCTION) {
+        lua_pop(L, 1);
+        lua_pushcfunction(L, JitDiagnostics_traceEvent);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, JitDiagnostics_HANDLER_REGINDEX);
+    }
+    if(attach) lua_pushstring(L, "trace");
+    lua_call(L, attach ? 2 : 1, 0);
+    return true;
+}
+bool JitDiagnostics_attach(lua_State *L) {
+    if(!pushModule(L, "jit.util")) {
+        debug_warn("Cannot attach JIT diagnostics, as LuaJIT is not loaded.");
+        return false;
+    }
+    lua_pop(L, 1);
+
+    onFlush();
+    loadTraceErrors(L);
+
+    if(!callAttach(L, true)) return false;
+    debug_print("Attached JIT trace diagnostics.");
+    return true;
+}
+void JitDiagnostics_detach(lua_State *L) {
+    if(callAttach(L, false)) debug_print("Detached JIT trace diagnostics.");
+}
+void JitDiagnostics_reset() {
+    Mutex_lock(&diagnosticsLock);
+    memset(locations, 0, sizeof(locations));
+    memset(reasons, 0, sizeof(reasons));
+    locationCount = reasonCount = 0;
+    droppedEvents = 0;
+    for(int i=0; i<MAX_TRACES; i++) traces[i].trace = -1;
+    Mutex_unlock(&diagnosticsLock);
+}
+
+// Reports
+static int compareLocations(const void* a, const void* b) {
+    const JitTraceLocation* locationA = a;
+    const JitTraceLocation* locationB = b;
+    if(locationA->aborted != locationB->aborted) return locationA->aborted < locationB->aborted ? 1 : -1;
+    if(locationA->started != locationB->started) return locationA->started < locationB->started ? 1 : -1;
+    return 0;
+}
+static int compareReasons(const void* a, const void* b) {
+    uint32_t countA = ((const JitAbortReason*) a)->count, countB = ((const JitAbortReason*) b)->count;
+    return countA < countB ? 1 : countA > countB ? -1 : 0;
+}
+int JitDiagnostics_getLocations(JitTraceLocation* out, int max) {
+    JitTraceLocation* all = malloc(sizeof(JitTraceLocation) * JIT_DIAGNOSTICS_MAX_LOCATIONS);
+    int count = 0;
+    Mutex_lock(&diagnosticsLock);
+    for(int i=0; i<JIT_DIAGNOSTICS_MAX_LOCATIONS; i++) if(locations[i].used) all[count++] = locations[i].data;
+    Mutex_unlock(&diagnosticsLock);
+
+    qsort(all, count, sizeof(JitTraceLocation), compareLocations);
+    if(count > max) count = max;
+    memcpy(out, all, sizeof(JitTraceLocation) * count);
+    free(all);
+    return count;
+}
+int JitDiagnostics_getReasons(JitAbortReason* out, int max) {
+    JitAbortReason all[JIT_DIAGNOSTICS_MAX_REASONS];
+    int count = 0;
+    Mutex_lock(&diagnosticsLock);
+    for(int i=0; i<JIT_DIAGNOSTICS_MAX_REASONS; i++) if(reasons[i].used) all[count++] = reasons[i].data;
+    Mutex_unlock(&diagnosticsLock);
+
+    qsort(all, count, sizeof(JitAbortReason), compareReasons);
+    if(count > max) count = max;
+    memcpy(out, all, sizeof(JitAbortReason) * count);
+    return count;
+}
+void JitDiagnostics_dump(int limit) {
+    if(limit <= 0 || limit > JIT_DIAGNOSTICS_MAX_LOCATIONS) limit = JIT_DIAGNOSTICS_MAX_LOCATIONS;
+    JitTraceLocation* ranked = malloc(sizeof(JitTraceLocation) * limit);
+    int count = JitDiagnostics_getLocations(ranked, limit);
+    JitAbortReason reasonList[JIT_DIAGNOSTICS_MAX_REASONS];
+    int reasonTotal = JitDiagnostics_getReasons(reasonList, JIT_DIAGNOSTICS_MAX_REASONS);
+
+    debug_print_raw("JIT trace report (%d locations, %u events dropped):", count, droppedEvents);
+    for(int i=0; i<count; i++)
+        debug_print_raw(" - %-48s %6u started, %6u completed, %6u aborted%s", ranked[i].location, ranked[i].started,
+                        ranked[i].completed, ranked[i].aborted, ranked[i].blacklisted ? ", blacklisted" : "");
+    debug_print_raw("Trace abort reasons:");
+    for(int i=0; i<reasonTotal; i++) debug_print_raw(" - %6u %s", reasonList[i].count, reasonList[i].reason);
+    free(ranked);
+}
@@ -0,0 +1,59 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lua.h"
+
+// Collects LuaJIT trace events through jit.attach, to find the UI scripts that never make it onto the JIT. Traces are
+// attributed to the source line they started at.
+#define JIT_DIAGNOSTICS_MAX_LOCATIONS 2048
+#define JIT_DIAGNOSTICS_MAX_REASONS   256
+#define JIT_DIAGNOSTICS_NAME_LENGTH   96
+
+typedef struct JitTraceLocation {
+    char location[JIT_DIAGNOSTICS_NAME_LENGTH];
+    uint32_t started;
+    uint32_t completed;
+    uint32_t aborted;
+    uint32_t blacklisted;
+    char lastReason[JIT_DIAGNOSTICS_NAME_LENGTH];
+} JitTraceLocation;
+
+typedef struct JitAbortReason {
+    char reason[JIT_DIAGNOSTICS_NAME_LENGTH];
+    uint32_t count;
+} JitAbortReason;
+
+// Attaches the collector to the Lua VM that L belongs to. Returns false if LuaJIT is not in use.
+bool JitDiagnostics_attach(lua_State *L);
+void JitDiagnostics_detach(lua_State *L);
+void JitDiagnostics_reset();
+
+// Copies up to max locations, ranked by aborted and then started traces. Returns how many were copied.
+int JitDiagnostics_getLocations(JitTraceLocation* out, int max);
+// Copies up to max abort reasons, ranked by count. Returns how many were copied.
+int JitDiagnostics_getReasons(JitAbortReason* out, int max);
+void JitDiagnostics_dump(int limit);
@@ -0,0 +1,327 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "sync.h"
+#include "lua_alloc.h"
+
+#include "lua.h"
+
+// Size classes step by 8 bytes up to 64, then by 16, 32 and 64 bytes up to LUA_ALLOC_MAX_SMALL.
+#define SIZE_CLASSES 19
+static const uint16_t classSizes[SIZE_CLASSES] = {
+    16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+static inline int sizeClass(size_t size) {
+    if(size <= 16 ) return 0;
+    if(size <= 64 ) return (size + 7) / 8 - 2;
+    if(size <= 128) return  6 + (size - 64  + 15) / 16;
+    if(size <= 256) return 10 + (size - 128 + 31) / 32;
+    return                 14 + (size - 256 + 63) / 64;
+}
+
+// Arenas
+//
+// Memory is reserved in arenas aligned to their own size, so whether a block belongs to the allocator can be decided
+// from its address alone, by looking up the arena number in a set. Arenas are never returned to the system.
+#define ARENA_SHIFT 20
+#define ARENA_SIZE (1 << ARENA_SHIFT)
+#define ARENA_SET_SIZE 4096
+#define RUN_SIZE (64 * 1024)
+
+static uintptr_t arenaSet[ARENA_SET_SIZE];
+static char* arenaCursor;
+static char* arenaEnd;
+static LuaAllocStats allocStats;
+static Mutex arenaLock = MUTEX_INITIALIZER;
+
+static inline uint32_t arenaSlot(uintptr_t arena) {
+    return (uint32_t) (arena * 2654435761U) % ARENA_SET_SIZE;
+}
+static bool isArenaBlock(void* ptr) {
+    uintptr_t arena = ((uintptr_t) ptr >> ARENA_SHIFT) + 1;
+    for(uint32_t i=0, slot = arenaSlot(arena); i<ARENA_SET_SIZE; i++, slot = (slot + 1) % ARENA_SET_SIZE) {
+        uintptr_t entry = __atomic_load_n(&arenaSet[slot], __ATOMIC_ACQUIRE);
+        if(entry == arena) return true;
+        if(entry == 0) return false;
+    }
+    return false;
+}
+static bool addArena(char* memory) {
+    uintptr_t arena = ((uintptr_t) memory >> ARENA_SHIFT) + 1;
+    if(allocStats.arenas >= ARENA_SET_SIZE * 3 / 4) return false;
+    uint32_t slot = arenaSlot(arena);
+    while(arenaSet[slot] != 0) slot = (slot + 1) % ARENA_SET_SIZE;
+    __atomic_store_n(&arenaSet[slot], arena, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Hands out RUN_SIZE pieces of the current arena, which threads then carve blocks out of without locking.
+static char* takeRun() {
+    Mutex_lock(&arenaLock);
+    if(arenaCursor == arenaEnd) {
+        char* memory = allocateAlignedMemory(ARENA_SIZE);
+        if(memory == NULL || !addArena(memory)) {
+            Mutex_unlock(&arenaLock);
+            return NULL;
+        }
+        arenaCursor = memory;
+        arenaEnd = memory + ARENA_SIZE;
+        allocStats.arenas++;
+        allocStats.arenaBytes += ARENA_SIZE;
+    }
+    char* run = arenaCursor;
+    arenaCursor += RUN_SIZE;
+    allocStats.carvedBytes += RUN_SIZE;
+    Mutex_unlock(&arenaLock);
+    return run;
+}
+
+// Thread-local pools
+//
+// Each thread keeps its own free lists, so blocks freed by one thread are reused by that thread. A thread's free
+// blocks are not reclaimed when it exits, which is fine for the game's long-lived threads.
+typedef struct FreeBlock {
+    struct FreeBlock* next;
+} FreeBlock;
+typedef struct ThreadPool {
+    FreeBlock* freeLists[SIZE_CLASSES];
+    char* runCursor;
+    char* runEnd;
+} ThreadPool;
+static __thread ThreadPool threadPool;
+
+static void* smallAlloc(int class) {
+    ThreadPool* pool = &threadPool;
+    FreeBlock* block = pool->freeLists[class];
+    if(block != NULL) {
+        pool->freeLists[class] = block->next;
+        return block;
+    }
+
+    size_t size = classSizes[class];
+    if(pool->runEnd - pool->runCursor < size) {
+        // The unused tail of the old run is recycled into the free list it fits.
+        size_t tail = pool->runEnd - pool->runCursor;
+        if(tail >= classSizes[0]) {
+            int tailClass = sizeClass(tail);
+            if(classSizes[tailClass] > tail) tailClass--;
+            FreeBlock* tailBlock = (FreeBlock*) pool->runCursor;
+            tailBlock->next = pool->freeLists[tailClass];
+            pool->freeLists[tailClass] = tailBlock;
+        }
+
+        char* run = takeRun();
+        if(run == NULL) return NULL;
+        pool->runCursor = run;
+        pool->runEnd = run + RUN_SIZE;
+    }
+    void* ptr = pool->runCursor;
+    pool->runCursor += size;
+    return ptr;
+}
+static void smallFree(void* ptr, int class) {
+    ThreadPool* pool = &threadPool;
+    FreeBlock* block = (FreeBlock*) ptr;
+    block->next = pool->freeLists[class];
+    pool->freeLists[class] = block;
+}
+
+// Per-state allocators
+//
+// Each installed state holds a slot, which is released by a finalizer on a sentinel userdata in its registry. lua_close
+// runs finalizers before freeing the rest of the state, and the blocks it frees afterwards include arena blocks, so the
+// original allocator cannot be put back from the finalizer. Instead, the finalizer records the main thread, and the
+// allocator record is freed along with it, since the main thread is the block lua_close frees last.
+#define LuaAllocator_SENTINEL_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_luaalloc"
+
+typedef struct StateAllocator {
+    lua_Alloc originalAlloc;
+    void* originalUd;
+    bool closed;
+    void* mainThread; // set once the state is closing
+    LuaAllocStateStats stats;
+} StateAllocator;
+static StateAllocator* states[LUA_ALLOC_MAX_STATES];
+static int stateCount = 0;
+static Mutex stateLock = MUTEX_INITIALIZER;
+
+static inline void updateLiveBytes(StateAllocator* state, size_t freed, size_t allocated) {
+    LuaAllocStateStats* stats = &state->stats;
+    stats->liveBytes = stats->liveBytes > freed ? stats->liveBytes - freed : 0;
+    stats->liveBytes += allocated;
+    if(stats->liveBytes > stats->highWaterBytes) stats->highWaterBytes = stats->liveBytes;
+}
+
+// Blocks in an arena are always small. Any other block, large or allocated before installation, belongs to the
+// original allocator.
+static void* LuaAllocator_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    StateAllocator* state = (StateAllocator*) ud;
+    LuaAllocStateStats* stats = &state->stats;
+    bool inArena = ptr != NULL && isArenaBlock(ptr);
+
+    if(ptr != NULL && !inArena && osize <= LUA_ALLOC_MAX_SMALL) stats->foreignFrees++;
+    if(nsize == 0) {
+        if(ptr == NULL) return NULL;
+        if(inArena) smallFree(ptr, sizeClass(osize));
+        else state->originalAlloc(state->originalUd, ptr, osize, 0);
+        stats->frees++;
+        updateLiveBytes(state, osize, 0);
+        if(state->closed && ptr == state->mainThread) free(state);
+        return NULL;
+    }
+
+    if(inArena && nsize <= LUA_ALLOC_MAX_SMALL && sizeClass(osize) == sizeClass(nsize)) {
+        updateLiveBytes(state, osize, nsize);
+        return ptr;
+    }
+
+    void* newPtr = NULL;
+    if(nsize <= LUA_ALLOC_MAX_SMALL) {
+        newPtr = smallAlloc(sizeClass(nsize));
+        if(newPtr != NULL) stats->smallAllocations++;
+    }
+    if(newPtr == NULL) {
+        // Large blocks stay with the original allocator, which can often grow them in place.
+        if(ptr != NULL && !inArena) {
+            newPtr = state->originalAlloc(state->originalUd, ptr, osize, nsize);
+            if(newPtr != NULL) updateLiveBytes(state, osize, nsize);
+            return newPtr;
+        }
+        newPtr = state->originalAlloc(state->originalUd, NULL, 0, nsize);
+        if(newPtr == NULL) return NULL;
+    }
+    stats->allocations++;
+
+    if(ptr != NULL) {
+        memcpy(newPtr, ptr, osize < nsize ? osize : nsize);
+        if(inArena) smallFree(ptr, sizeClass(osize));
+        else state->originalAlloc(state->originalUd, ptr, osize, 0);
+        stats->frees++;
+    }
+    updateLiveBytes(state, ptr != NULL ? osize : 0, nsize);
+    return newPtr;
+}
+
+static int LuaAllocator_closeState(lua_State *L) {
+    StateAllocator* state = *(StateAllocator**) lua_touserdata(L, 1);
+    Mutex_lock(&stateLock);
+    states[state->stats.id] = NULL;
+    stateCount--;
+    state->closed = true;
+    state->mainThread = L; // lua_close runs finalizers on the main thread
+    Mutex_unlock(&stateLock);
+    debug_print("Released the pool allocator slot of Lua state %d.", state->stats.id);
+    return 0;
+}
+
+// LuaJIT's own allocator, as used by luaL_newstate, found by probing a throwaway state. lua_close only destroys its heap
+// if it is still the state's allocator, and it cannot be put back before the state's arena blocks are freed, so states
+// using it are left alone. It already pools small blocks in a per-state heap.
+typedef lua_State* (*luaL_newstate_t)();
+typedef lua_Alloc  (*lua_getallocf_t)(lua_State *L, void **ud);
+typedef void       (*lua_close_t)(lua_State *L);
+static lua_Alloc luaJITAlloc = NULL;
+static bool luaJITAllocProbed = false;
+static lua_Alloc findLuaJITAlloc() {
+    if(luaJITAllocProbed) return luaJITAlloc;
+    luaJITAllocProbed = true;
+
+    luaL_newstate_t newstate  = (luaL_newstate_t) resolveLuaJITSymbol("luaL_newstate");
+    lua_getallocf_t getallocf = (lua_getallocf_t) resolveLuaJITSymbol("lua_getallocf");
+    lua_close_t     close     = (lua_close_t    ) resolveLuaJITSymbol("lua_close"    );
+    if(newstate == NULL || getallocf == NULL || close == NULL) return NULL;
+
+    lua_State* probe = newstate();
+    if(probe == NULL) return NULL;
+    luaJITAlloc = getallocf(probe, NULL);
+    close(probe);
+    return luaJITAlloc;
+}
+
+int LuaAllocator_install(lua_State *L) {
+    void* ud;
+    lua_Alloc originalAlloc = lua_getallocf(L, &ud);
+    if(originalAlloc == LuaAllocator_alloc) return ((StateAllocator*) ud)->stats.id;
+
+    Mutex_lock(&stateLock);
+    if(originalAlloc == findLuaJITAlloc()) {
+        Mutex_unlock(&stateLock);
+        debug_print("Lua state uses LuaJIT's own allocator, not installing the pool allocator.");
+        return -1;
+    }
+    int id = 0;
+    while(id < LUA_ALLOC_MAX_STATES && states[id] != NULL) id++;
+    if(id == LUA_ALLOC_MAX_STATES) {
+        Mutex_unlock(&stateLock);
+        debug_warn("Too many Lua states, not installing the pool allocator.");
+        return -1;
+    }
+    StateAllocator* state = calloc(1, sizeof(StateAllocator));
+    state->originalAlloc = originalAlloc;
+    state->originalUd = ud;
+    state->stats.id = id;
+
+    // Blocks allocated before installation are freed through this allocator too, so they are counted from the start.
+    state->stats.liveBytes = (uint64_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+    state->stats.highWaterBytes = state->stats.liveBytes;
+    states[id] = state;
+    stateCount++;
+    Mutex_unlock(&stateLock);
+
+    lua_setallocf(L, LuaAllocator_alloc, state);
+
+    StateAllocator** sentinel = lua_newuserdata(L, sizeof(StateAllocator*));
+    *sentinel = state;
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, LuaAllocator_closeState);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, LuaAllocator_SENTINEL_REGINDEX);
+
+    debug_print("Installed the pool allocator on Lua state %d.", id);
+    return id;
+}
+int LuaAllocator_stateId(lua_State *L) {
+    void* ud;
+    if(lua_getallocf(L, &ud) != LuaAllocator_alloc) return -1;
+    return ((StateAllocator*) ud)->stats.id;
+}
+bool LuaAllocator_getStateStats(int id, LuaAllocStateStats* stats) {
+    Mutex_lock(&stateLock);
+    bool isValid = id >= 0 && id < LUA_ALLOC_MAX_STATES && states[id] != NULL;
+    if(isValid) *stats = states[id]->stats;
+    Mutex_unlock(&stateLock);
+    return isValid;
+}
+void LuaAllocator_getStats(LuaAllocStats* stats) {
+    Mutex_lock(&arenaLock);
+    *stats = allocStats;
+    Mutex_unlock(&arenaLock);
+    Mutex_lock(&stateLock);
+    stats->states = stateCount;
+    Mutex_unlock(&stateLock);
+}
@@ -0,0 +1,61 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lua.h"
+
+// A size-class pool allocator for Lua states. Small blocks come from thread-local free lists backed by large aligned
+// arenas, while larger blocks and blocks allocated before the allocator was installed are passed to the state's
+// original allocator.
+#define LUA_ALLOC_MAX_SMALL 512
+#define LUA_ALLOC_MAX_STATES 64
+
+// liveBytes matches Lua's own count of memory in use. foreignFrees counts small blocks that were allocated before the
+// allocator was installed.
+typedef struct LuaAllocStateStats {
+    int id;
+    uint64_t liveBytes;
+    uint64_t highWaterBytes;
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t smallAllocations;
+    uint32_t foreignFrees;
+} LuaAllocStateStats;
+
+typedef struct LuaAllocStats {
+    uint32_t arenas;
+    uint64_t arenaBytes;
+    uint64_t carvedBytes;
+    int states; // states the allocator is installed on and that have not been closed
+} LuaAllocStats;
+
+// Installs the allocator on the Lua VM that L belongs to, unless it is already installed. Returns the state's id, or -1
+// if no more states can be tracked or the state uses LuaJIT's own allocator. Ids are below LUA_ALLOC_MAX_STATES, and are reused once a state is closed.
+int LuaAllocator_install(lua_State *L);
+// Returns the id of the allocator installed on L's VM, or -1 if it is not installed.
+int LuaAllocator_stateId(lua_State *L);
+bool LuaAllocator_getStateStats(int id, LuaAllocStateStats* stats);
+void LuaAllocator_getStats(LuaAllocStats* stats);
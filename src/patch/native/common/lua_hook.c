@@ -27,6 +27,7 @@
 // Like throwing a fatal error. :|
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -37,6 +38,17 @@
 #include "lua_hook.h"
 #include "net_hook.h"
 #include "config.h"
+#include "startup_profile.h"
+#include "metrics.h"
+#include "mod_codec.h"
+#include "telemetry.h"
+#include "frame_stats.h"
+#include "lua_profiler.h"
+#include "sampling_profiler.h"
+#include "jit_diagnostics.h"
+#include "lua_alloc.h"
+#include "gc_pacer.h"
+#include "chunk_cache.h"
 
 #include "lua.h"
 #include "lauxlib.h"
@@ -44,6 +56,9 @@
 // Setup new Lua tables
 #define LuaTableHook_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6"
 #define LuaTableHook_SENTINEL "216f0090-85dd-4061-8371-3d8ba2099a70"
+#define LuaTableHook_TABLE_REGINDEX      "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_table"
+#define LuaTableHook_GENERATION_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_generation"
+#define LuaTableHook_MEMORY_REGINDEX     "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_memory"
 
 static void table_setTable(lua_State *L, int table, const char* name, void (*fn)(lua_State *L, int table)) {
     lua_pushstring(L, name);
@@ -77,10 +92,53 @@ static int luaHook_NetPatch_pushMod(lua_State *L) {
     NetPatch_pushMod(luaL_checkstring(L, 1), luaL_checkinteger(L, 2));
     return 0;
 }
+static bool luaHook_readModInfo(lua_State *L, int record, ModInfo* info) {
+    lua_pushstring(L, "ID");
+    lua_rawget(L, record);
+    if(lua_type(L, -1) != LUA_TSTRING) {
+        lua_pop(L, 1);
+        lua_pushstring(L, "ModID");
+        lua_rawget(L, record);
+    }
+    lua_pushstring(L, "Version");
+    lua_rawget(L, record);
+
+    bool isValid = lua_type(L, -2) == LUA_TSTRING && lua_isnumber(L, -1);
+    if(isValid) {
+        strncpy(info->modId, lua_tostring(L, -2), 64);
+        info->modId[63] = '\0';
+        info->version = lua_tointeger(L, -1);
+    }
+    lua_pop(L, 2);
+    return isValid;
+}
+static int luaHook_NetPatch_pushMods(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int count = lua_objlen(L, 1);
+    if(count == 0) return 0;
+
+    ModInfo* mods = malloc(sizeof(ModInfo) * count);
+    for(int i=0; i<count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        bool isValid = lua_type(L, -1) == LUA_TTABLE && luaHook_readModInfo(L, lua_gettop(L), &mods[i]);
+        lua_pop(L, 1);
+        if(!isValid) {
+            free(mods);
+            return luaL_error(L, "invalid mod record at index %d", i + 1);
+        }
+    }
+    NetPatch_pushMods(mods, count);
+    free(mods);
+    return 0;
+}
 static int luaHook_NetPatch_overrideReloadMods(lua_State *L) {
     NetPatch_overrideReloadMods(lua_toboolean(L, 1));
     return 0;
 }
+static int luaHook_NetPatch_allowReloadSkip(lua_State *L) {
+    NetPatch_allowReloadSkip(lua_toboolean(L, 1));
+    return 0;
+}
 static int luaHook_NetPatch_overrideModList(lua_State *L) {
     NetPatch_overrideModList();
     return 0;
@@ -91,6 +149,25 @@ static int luaHook_NetPatch_pushDLC(lua_State *L) {
                      (((uint64_t) luaL_checkinteger(L, 4) << 32) & 0xFFFFFFFF) | (luaL_checkinteger(L, 5) & 0xFFFFFFFF));
     return 0;
 }
+static int luaHook_NetPatch_pushDLCs(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int count = lua_objlen(L, 1);
+    if(count == 0) return 0;
+
+    GUID* guids = malloc(sizeof(GUID) * count);
+    for(int i=0; i<count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        bool isValid = lua_type(L, -1) == LUA_TSTRING && NetPatch_parseGUID(lua_tostring(L, -1), &guids[i]);
+        lua_pop(L, 1);
+        if(!isValid) {
+            free(guids);
+            return luaL_error(L, "invalid DLC GUID at index %d", i + 1);
+        }
+    }
+    NetPatch_pushDLCs(guids, count);
+    free(guids);
+    return 0;
+}
 static int luaHook_NetPatch_overrideReloadDLC(lua_State *L) {
     NetPatch_overrideReloadDLC(lua_toboolean(L, 1));
     return 0;
@@ -100,25 +177,62 @@ static int luaHook_NetPatch_overrideDLCList(lua_State *L) {
     return 0;
 }
 
+// Full collections in the installing state are deferred until the override has been applied or reset.
 static int luaHook_NetPatch_install(lua_State *L) {
     NetPatch_install();
+    GcPacer_deferWhile(L, "modReload", NetPatch_isArmed, gcUpdateBudgetMicros > 0);
     return 0;
 }
 static int luaHook_NetPatch_reset(lua_State *L) {
     NetPatch_reset();
+    GcPacer_resume(L, "modReload");
     return 0;
 }
+static int luaHook_NetPatch_isArmed(lua_State *L) {
+    lua_pushboolean(L, NetPatch_isArmed());
+    return 1;
+}
+static int luaHook_NetPatch_allocatorStats(lua_State *L) {
+    CppListLinkStats stats;
+    CppListLink_getStats(&stats);
+
+    lua_createtable(L, 0, 5);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "slabAllocations", stats.slabAllocations);
+    table_setInteger(L, table, "bytesAllocated" , stats.bytesAllocated );
+    table_setInteger(L, table, "linkAllocations", stats.linkAllocations);
+    table_setInteger(L, table, "linkFrees"      , stats.linkFrees      );
+    table_setInteger(L, table, "linksLive"      , stats.linksLive      );
+    return 1;
+}
+static int luaHook_NetPatch_lockStats(lua_State *L) {
+    MutexStats stats;
+    NetPatch_getLockStats(&stats);
+
+    lua_createtable(L, 0, 3);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "acquisitions", stats.acquisitions    );
+    table_setInteger(L, table, "contentions" , stats.contentions     );
+    table_setInteger(L, table, "waitMicros"  , stats.waitNanos / 1000);
+    return 1;
+}
 static void luaTable_NetPatch(lua_State *L, int table) {
     table_setCFunction(L, table, "pushMod"           , luaHook_NetPatch_pushMod           );
+    table_setCFunction(L, table, "pushMods"          , luaHook_NetPatch_pushMods          );
     table_setCFunction(L, table, "overrideReloadMods", luaHook_NetPatch_overrideReloadMods);
     table_setCFunction(L, table, "overrideModList"   , luaHook_NetPatch_overrideModList   );
 
     table_setCFunction(L, table, "pushDLC"           , luaHook_NetPatch_pushDLC           );
+    table_setCFunction(L, table, "pushDLCs"          , luaHook_NetPatch_pushDLCs          );
     table_setCFunction(L, table, "overrideReloadDLC" , luaHook_NetPatch_overrideReloadDLC );
     table_setCFunction(L, table, "overrideDLCList"   , luaHook_NetPatch_overrideDLCList   );
 
+    table_setCFunction(L, table, "allowReloadSkip"   , luaHook_NetPatch_allowReloadSkip   );
     table_setCFunction(L, table, "install"           , luaHook_NetPatch_install           );
     table_setCFunction(L, table, "reset"             , luaHook_NetPatch_reset             );
+    table_setCFunction(L, table, "isArmed"           , luaHook_NetPatch_isArmed           );
+    table_setCFunction(L, table, "allocatorStats"    , luaHook_NetPatch_allocatorStats    );
+    table_setCFunction(L, table, "lockStats"         , luaHook_NetPatch_lockStats         );
 }
 
 static int luaHook_debugPrint(lua_State *L) {
@@ -174,49 +288,549 @@ static void luaTable_globals(lua_State *L, int table) {
     lua_pop(L, 1);
 }
 
+static void luaTable_startup(lua_State *L, int table) {
+    table_setInteger(L, table, "totalMicros", StartupProfile_totalNanos() / 1000);
+
+    int phaseCount = StartupProfile_phaseCount();
+    uint64_t startTime = phaseCount == 0 ? 0 : StartupProfile_getPhase(0)->startNanos;
+    lua_pushstring(L, "phases");
+    lua_createtable(L, phaseCount, 0);
+    int phases = lua_gettop(L);
+    for(int i=0; i<phaseCount; i++) {
+        const StartupPhase* phase = StartupProfile_getPhase(i);
+        lua_createtable(L, 0, 3 + STARTUP_COUNTER_COUNT);
+        int entry = lua_gettop(L);
+        table_setString (L, entry, "name"          , phase->name);
+        table_setInteger(L, entry, "startMicros"   , (phase->startNanos - startTime) / 1000);
+        table_setInteger(L, entry, "durationMicros", (phase->endNanos - phase->startNanos) / 1000);
+        for(int j=0; j<STARTUP_COUNTER_COUNT; j++)
+            table_setInteger(L, entry, StartupProfile_counterName(j), phase->counters[j]);
+        lua_rawseti(L, phases, i + 1);
+    }
+    lua_rawset(L, table);
+}
+
+static int luaHook_stats_snapshot(lua_State *L) {
+    lua_createtable(L, 0, HOOK_METRIC_COUNT);
+    int table = lua_gettop(L);
+    for(int metric=0; metric<HOOK_METRIC_COUNT; metric++) {
+        HookMetrics metrics;
+        Metrics_snapshot(metric, &metrics);
+
+        lua_pushstring(L, Metrics_name(metric));
+        lua_createtable(L, 0, 4);
+        int entry = lua_gettop(L);
+        table_setInteger(L, entry, "calls"      , metrics.calls);
+        table_setInteger(L, entry, "totalMicros", metrics.totalNanos / 1000);
+        table_setInteger(L, entry, "maxMicros"  , metrics.maxNanos / 1000);
+
+        lua_pushstring(L, "histogram");
+        lua_createtable(L, METRICS_HISTOGRAM_BUCKETS, 0);
+        int histogram = lua_gettop(L);
+        for(int i=0; i<METRICS_HISTOGRAM_BUCKETS; i++) {
+            lua_pushinteger(L, metrics.histogram[i]);
+            lua_rawseti(L, histogram, i + 1);
+        }
+        lua_rawset(L, entry);
+
+        lua_rawset(L, table);
+    }
+    return 1;
+}
+static int luaHook_stats_reset(lua_State *L) {
+    Metrics_reset();
+    return 0;
+}
+static int luaHook_stats_reloads(lua_State *L) {
+    ReloadStats stats;
+    NetPatch_getReloadStats(&stats);
+
+    lua_createtable(L, 0, 7);
+    int table = lua_gettop(L);
+    table_setString (L, table, "lastDecision", NetPatch_reloadDecisionName(stats.lastDecision));
+    table_setInteger(L, table, "reloads"     , stats.reloads           );
+    table_setInteger(L, table, "skipped"     , stats.skipped           );
+    table_setInteger(L, table, "reloadMicros", stats.reloadNanos / 1000);
+    table_setInteger(L, table, "savedMicros" , stats.savedNanos / 1000 );
+    table_setInteger(L, table, "listsCopied" , stats.listsCopied       );
+    table_setInteger(L, table, "listsReused" , stats.listsReused       );
+    return 1;
+}
+static void luaTable_hookTimes(lua_State *L, int table, const uint64_t* nanos, const uint32_t* calls) {
+    for(int metric=0; metric<HOOK_METRIC_COUNT; metric++) {
+        lua_pushstring(L, Metrics_name(metric));
+        lua_createtable(L, 0, 2);
+        int entry = lua_gettop(L);
+        table_setInteger(L, entry, "calls" , calls[metric]        );
+        table_setInteger(L, entry, "micros", nanos[metric] / 1000);
+        lua_rawset(L, table);
+    }
+}
+static int luaHook_stats_frames(lua_State *L) {
+    FrameStats stats;
+    FrameStats_get(&stats);
+    FrameIncident incidents[FRAME_INCIDENT_COUNT];
+    int incidentCount = FrameStats_getIncidents(incidents, FRAME_INCIDENT_COUNT);
+
+    lua_createtable(L, 0, 5);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "frames"      , stats.frames               );
+    table_setInteger(L, table, "hitches"     , stats.hitches              );
+    table_setInteger(L, table, "budgetMicros", stats.budgetNanos / 1000   );
+
+    lua_pushstring(L, "histogram");
+    lua_createtable(L, FRAME_HISTOGRAM_BUCKETS, 0);
+    int histogram = lua_gettop(L);
+    for(int i=0; i<FRAME_HISTOGRAM_BUCKETS; i++) {
+        lua_pushinteger(L, stats.histogram[i]);
+        lua_rawseti(L, histogram, i + 1);
+    }
+    lua_rawset(L, table);
+
+    lua_pushstring(L, "incidents");
+    lua_createtable(L, incidentCount, 0);
+    int list = lua_gettop(L);
+    for(int i=0; i<incidentCount; i++) {
+        lua_createtable(L, 0, 4);
+        int entry = lua_gettop(L);
+        table_setInteger(L, entry, "frame"         , incidents[i].frame                );
+        table_setInteger(L, entry, "intervalMicros", incidents[i].intervalNanos / 1000 );
+        table_setInteger(L, entry, "logEntries"    , incidents[i].logEntries           );
+
+        lua_pushstring(L, "hooks");
+        lua_createtable(L, 0, HOOK_METRIC_COUNT);
+        luaTable_hookTimes(L, lua_gettop(L), incidents[i].hookNanos, incidents[i].hookCalls);
+        lua_rawset(L, entry);
+
+        lua_rawseti(L, list, i + 1);
+    }
+    lua_rawset(L, table);
+    return 1;
+}
+static int luaHook_stats_luaProfile(lua_State *L) {
+    LuaChunkProfile* profiles = malloc(sizeof(LuaChunkProfile) * (LUA_PROFILER_MAX_CHUNKS + 1));
+    int count = LuaProfiler_snapshot(profiles, LUA_PROFILER_MAX_CHUNKS + 1);
+
+    lua_createtable(L, count, 0);
+    int list = lua_gettop(L);
+    for(int i=0; i<count; i++) {
+        lua_createtable(L, 0, 5);
+        int entry = lua_gettop(L);
+        table_setString (L, entry, "chunk"      , profiles[i].name             );
+        table_setInteger(L, entry, "calls"      , profiles[i].calls            );
+        table_setInteger(L, entry, "totalMicros", profiles[i].totalNanos / 1000);
+        table_setInteger(L, entry, "selfMicros" , profiles[i].selfNanos / 1000 );
+        table_setInteger(L, entry, "maxMicros"  , profiles[i].maxNanos / 1000  );
+        lua_rawseti(L, list, i + 1);
+    }
+    free(profiles);
+
+    if(lua_toboolean(L, 1)) LuaProfiler_reset();
+    return 1;
+}
+static int luaHook_stats_dumpLuaProfile(lua_State *L) {
+    LuaProfiler_dump();
+    return 0;
+}
+static int luaHook_stats_chunkCache(lua_State *L) {
+    ChunkCacheStats stats;
+    ChunkCache_getStats(&stats);
+
+    lua_createtable(L, 0, 8);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "entries"      , stats.entries            );
+    table_setInteger(L, table, "bytes"        , stats.bytes              );
+    table_setInteger(L, table, "hits"         , stats.hits               );
+    table_setInteger(L, table, "misses"       , stats.misses             );
+    table_setInteger(L, table, "uncached"     , stats.uncached           );
+    table_setInteger(L, table, "compileMicros", stats.compileNanos / 1000);
+    table_setInteger(L, table, "loadMicros"   , stats.loadNanos / 1000   );
+    table_setInteger(L, table, "savedMicros"  , stats.savedNanos / 1000  );
+    return 1;
+}
+static void luaTable_stats(lua_State *L, int table) {
+    table_setCFunction(L, table, "snapshot", luaHook_stats_snapshot);
+    table_setCFunction(L, table, "reset"   , luaHook_stats_reset   );
+    table_setCFunction(L, table, "reloads" , luaHook_stats_reloads );
+    table_setCFunction(L, table, "frames"  , luaHook_stats_frames  );
+    table_setCFunction(L, table, "luaProfile"    , luaHook_stats_luaProfile    );
+    table_setCFunction(L, table, "dumpLuaProfile", luaHook_stats_dumpLuaProfile);
+    table_setCFunction(L, table, "chunkCache"    , luaHook_stats_chunkCache    );
+}
+
+static int luaHook_profiler_start(lua_State *L) {
+    lua_pushboolean(L, SamplingProfiler_start(L, luaL_optinteger(L, 1, samplingIntervalMillis)));
+    return 1;
+}
+static int luaHook_profiler_stop(lua_State *L) {
+    SamplingProfiler_stop(L);
+    return 0;
+}
+static int luaHook_profiler_reset(lua_State *L) {
+    SamplingProfiler_reset();
+    return 0;
+}
+static void luaHook_profiler_addPath(const char* path, void* data) {
+    lua_State *L = (lua_State*) data;
+    lua_pushstring(L, path);
+    lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+}
+static int luaHook_profiler_dump(lua_State *L) {
+    const char* context = lua_isnoneornil(L, 1) ? NULL : luaL_checkstring(L, 1);
+    lua_createtable(L, 0, 0);
+    SamplingProfiler_dump(context, luaHook_profiler_addPath, L);
+    return 1;
+}
+static int luaHook_profiler_stats(lua_State *L) {
+    SamplingProfilerStats stats;
+    SamplingProfiler_getStats(&stats);
+
+    lua_createtable(L, 0, 5);
+    int table = lua_gettop(L);
+    table_setBoolean(L, table, "running"       , stats.running       );
+    table_setInteger(L, table, "intervalMillis", stats.intervalMillis);
+    table_setInteger(L, table, "samples"       , stats.samples       );
+    table_setInteger(L, table, "stacks"        , stats.stacks        );
+    table_setInteger(L, table, "dropped"       , stats.dropped       );
+    return 1;
+}
+static void luaTable_profiler(lua_State *L, int table) {
+    table_setCFunction(L, table, "start", luaHook_profiler_start);
+    table_setCFunction(L, table, "stop" , luaHook_profiler_stop );
+    table_setCFunction(L, table, "reset", luaHook_profiler_reset);
+    table_setCFunction(L, table, "dump" , luaHook_profiler_dump );
+    table_setCFunction(L, table, "stats", luaHook_profiler_stats);
+}
+
+static int luaHook_jit_attach(lua_State *L) {
+    lua_pushboolean(L, JitDiagnostics_attach(L));
+    return 1;
+}
+static int luaHook_jit_detach(lua_State *L) {
+    JitDiagnostics_detach(L);
+    return 0;
+}
+static int luaHook_jit_reset(lua_State *L) {
+    JitDiagnostics_reset();
+    return 0;
+}
+static int luaHook_jit_report(lua_State *L) {
+    int limit = luaL_optinteger(L, 1, JIT_DIAGNOSTICS_MAX_LOCATIONS);
+    if(limit <= 0 || limit > JIT_DIAGNOSTICS_MAX_LOCATIONS) limit = JIT_DIAGNOSTICS_MAX_LOCATIONS;
+    JitTraceLocation* locations = malloc(sizeof(JitTraceLocation) * limit);
+    int locationCount = JitDiagnostics_getLocations(locations, limit);
+    JitAbortReason reasons[JIT_DIAGNOSTICS_MAX_REASONS];
+    int reasonCount = JitDiagnostics_getReasons(reasons, JIT_DIAGNOSTICS_MAX_REASONS);
+
+    lua_createtable(L, 0, 2);
+    int table = lua_gettop(L);
+
+    lua_pushstring(L, "locations");
+    lua_createtable(L, locationCount, 0);
+    int list = lua_gettop(L);
+    for(int i=0; i<locationCount; i++) {
+        lua_createtable(L, 0, 6);
+        int entry = lua_gettop(L);
+        table_setString (L, entry, "location"   , locations[i].location   );
+        table_setInteger(L, entry, "started"    , locations[i].started    );
+        table_setInteger(L, entry, "completed"  , locations[i].completed  );
+        table_setInteger(L, entry, "aborted"    , locations[i].aborted    );
+        table_setInteger(L, entry, "blacklisted", locations[i].blacklisted);
+        table_setString (L, entry, "lastReason" , locations[i].lastReason );
+        lua_rawseti(L, list, i + 1);
+    }
+    lua_rawset(L, table);
+    free(locations);
+
+    lua_pushstring(L, "reasons");
+    lua_createtable(L, reasonCount, 0);
+    list = lua_gettop(L);
+    for(int i=0; i<reasonCount; i++) {
+        lua_createtable(L, 0, 2);
+        int entry = lua_gettop(L);
+        table_setString (L, entry, "reason", reasons[i].reason);
+        table_setInteger(L, entry, "count" , reasons[i].count );
+        lua_rawseti(L, list, i + 1);
+    }
+    lua_rawset(L, table);
+    return 1;
+}
+static int luaHook_jit_dump(lua_State *L) {
+    JitDiagnostics_dump(luaL_optinteger(L, 1, 0));
+    return 0;
+}
+static void luaTable_jit(lua_State *L, int table) {
+    table_setCFunction(L, table, "attach", luaHook_jit_attach);
+    table_setCFunction(L, table, "detach", luaHook_jit_detach);
+    table_setCFunction(L, table, "reset" , luaHook_jit_reset );
+    table_setCFunction(L, table, "report", luaHook_jit_report);
+    table_setCFunction(L, table, "dump"  , luaHook_jit_dump  );
+}
+
+static void luaHook_pushAllocStateStats(lua_State *L, const LuaAllocStateStats* stats) {
+    lua_createtable(L, 0, 7);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "id"              , stats->id                   );
+    table_setInteger(L, table, "liveKB"          , stats->liveBytes / 1024     );
+    table_setInteger(L, table, "highWaterKB"     , stats->highWaterBytes / 1024);
+    table_setInteger(L, table, "allocations"     , stats->allocations          );
+    table_setInteger(L, table, "frees"           , stats->frees                );
+    table_setInteger(L, table, "smallAllocations", stats->smallAllocations     );
+    table_setInteger(L, table, "foreignFrees"    , stats->foreignFrees         );
+}
+static int luaHook_memory_install(lua_State *L) {
+    lua_pushinteger(L, LuaAllocator_install(L));
+    return 1;
+}
+static int luaHook_memory_state(lua_State *L) {
+    LuaAllocStateStats stats;
+    if(!LuaAllocator_getStateStats(LuaAllocator_stateId(L), &stats)) return 0;
+    luaHook_pushAllocStateStats(L, &stats);
+    return 1;
+}
+static int luaHook_memory_stats(lua_State *L) {
+    LuaAllocStats stats;
+    LuaAllocator_getStats(&stats);
+
+    lua_createtable(L, 0, 4);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "arenas"  , stats.arenas            );
+    table_setInteger(L, table, "arenaKB" , stats.arenaBytes / 1024 );
+    table_setInteger(L, table, "carvedKB", stats.carvedBytes / 1024);
+
+    lua_pushstring(L, "states");
+    lua_createtable(L, stats.states, 0);
+    int list = lua_gettop(L), count = 0;
+    for(int i=0; i<LUA_ALLOC_MAX_STATES; i++) {
+        LuaAllocStateStats stateStats;
+        if(!LuaAllocator_getStateStats(i, &stateStats)) continue;
+        luaHook_pushAllocStateStats(L, &stateStats);
+        lua_rawseti(L, list, ++count);
+    }
+    lua_rawset(L, table);
+    return 1;
+}
+static void luaTable_memory(lua_State *L, int table) {
+    table_setCFunction(L, table, "install", luaHook_memory_install);
+    table_setCFunction(L, table, "state"  , luaHook_memory_state  );
+    table_setCFunction(L, table, "stats"  , luaHook_memory_stats  );
+}
+
+static int luaHook_gc_step(lua_State *L) {
+    int budgetMicros = luaL_optinteger(L, 1, gcUpdateBudgetMicros);
+    lua_pushboolean(L, GcPacer_step(L, (uint64_t) budgetMicros * 1000, luaL_optinteger(L, 2, 0)));
+    return 1;
+}
+static int luaHook_gc_collect(lua_State *L) {
+    lua_pushboolean(L, GcPacer_collect(L));
+    return 1;
+}
+static int luaHook_gc_defer(lua_State *L) {
+    // Only stop the automatic collector if budgeted steps run every update to replace it.
+    GcPacer_defer(L, luaL_checkstring(L, 1), gcUpdateBudgetMicros > 0);
+    return 0;
+}
+static int luaHook_gc_resume(lua_State *L) {
+    GcPacer_resume(L, luaL_checkstring(L, 1));
+    return 0;
+}
+static int luaHook_gc_deferrals(lua_State *L) {
+    const char* reason = luaL_optstring(L, 1, NULL);
+    lua_pushinteger(L, reason != NULL ? GcPacer_isDeferred(L, reason) : GcPacer_deferrals(L));
+    return 1;
+}
+static int luaHook_gc_setPause(lua_State *L) {
+    lua_pushinteger(L, GcPacer_setPause(L, luaL_checkinteger(L, 1)));
+    return 1;
+}
+static int luaHook_gc_setStepMul(lua_State *L) {
+    lua_pushinteger(L, GcPacer_setStepMul(L, luaL_checkinteger(L, 1)));
+    return 1;
+}
+static int luaHook_gc_stats(lua_State *L) {
+    GcStats stats;
+    GcPacer_getStats(&stats);
+    if(lua_toboolean(L, 1)) GcPacer_resetStats();
+
+    lua_createtable(L, 0, 11);
+    int table = lua_gettop(L);
+    table_setInteger(L, table, "memoryKB"           , lua_gc(L, LUA_GCCOUNT, 0)        );
+    table_setInteger(L, table, "deferrals"          , GcPacer_deferrals(L)             );
+    table_setInteger(L, table, "stepCalls"          , stats.stepCalls                  );
+    table_setInteger(L, table, "steps"              , stats.steps                      );
+    table_setInteger(L, table, "skippedSteps"       , stats.skippedSteps               );
+    table_setInteger(L, table, "cycles"             , stats.cycles                     );
+    table_setInteger(L, table, "stepMicros"         , stats.stepNanos / 1000           );
+    table_setInteger(L, table, "maxStepMicros"      , stats.maxStepNanos / 1000        );
+    table_setInteger(L, table, "fullCollections"    , stats.fullCollections            );
+    table_setInteger(L, table, "fullCollectMicros"  , stats.fullCollectionNanos / 1000 );
+    table_setInteger(L, table, "deferredCollections", stats.deferredCollections        );
+    return 1;
+}
+static void luaTable_gc(lua_State *L, int table) {
+    table_setCFunction(L, table, "step"      , luaHook_gc_step      );
+    table_setCFunction(L, table, "collect"   , luaHook_gc_collect   );
+    table_setCFunction(L, table, "defer"     , luaHook_gc_defer     );
+    table_setCFunction(L, table, "resume"    , luaHook_gc_resume    );
+    table_setCFunction(L, table, "deferrals" , luaHook_gc_deferrals );
+    table_setCFunction(L, table, "setPause"  , luaHook_gc_setPause  );
+    table_setCFunction(L, table, "setStepMul", luaHook_gc_setStepMul);
+    table_setCFunction(L, table, "stats"     , luaHook_gc_stats     );
+}
+
+static void luaTable_ModCodec(lua_State *L, int table) {
+    table_setCFunction(L, table, "encodeModsList", ModCodec_encodeModsList);
+    table_setCFunction(L, table, "decodeModsList", ModCodec_decodeModsList);
+}
+
 static void luaTable_config(lua_State *L, int table) {
     table_setBoolean(L, table, "enableLogging"         , enableLogging         );
     table_setBoolean(L, table, "enableDebug"           , enableDebug           );
     table_setBoolean(L, table, "enableMultiplayerPatch", enableMultiplayerPatch);
     table_setBoolean(L, table, "enableLuaJIT"          , enableLuaJIT          );
+    table_setBoolean(L, table, "enableStartupProfileDump", enableStartupProfileDump);
+    table_setBoolean(L, table, "enablePermanentNetHook", enablePermanentNetHook);
+    table_setBoolean(L, table, "disableReloadSkip"     , disableReloadSkip     );
+    table_setBoolean(L, table, "enableTelemetry"       , enableTelemetry       );
+    table_setBoolean(L, table, "enableFrameHitchDetector", enableFrameHitchDetector);
+    table_setInteger(L, table, "frameBudgetMillis"     , frameBudgetMillis     );
+    table_setBoolean(L, table, "enableLuaProfiler"     , enableLuaProfiler     );
+    table_setBoolean(L, table, "enableSamplingProfiler", enableSamplingProfiler);
+    table_setInteger(L, table, "samplingIntervalMillis", samplingIntervalMillis);
+    table_setBoolean(L, table, "enableJitDiagnostics"  , enableJitDiagnostics  );
+    table_setBoolean(L, table, "enableLuaAllocator"    , enableLuaAllocator    );
+    table_setInteger(L, table, "gcUpdateBudgetMicros"  , gcUpdateBudgetMicros  );
+    table_setBoolean(L, table, "enableChunkCache"      , enableChunkCache      );
 }
 
-lGetMemoryUsage_t lGetMemoryUsage;
-ENTRY lGetMemoryUsage_attributes int lGetMemoryUsageProxy(lua_State *L) {
-    if(lua_type(L, 1) == LUA_TSTRING && !strcmp(luaL_checkstring(L, 1), LuaTableHook_SENTINEL)) {
-        debug_print("Found sentinel value, returning MPPatch table.")
+// The MPPatch table only depends on the patch's own state, so it is built once per lua_State and kept in the registry.
+// LuaTableHook_invalidate forces every state to rebuild it on its next sentinel call, e.g. after a config change.
+static int tableGeneration = 1;
+void LuaTableHook_invalidate() {
+    __atomic_add_fetch(&tableGeneration, 1, __ATOMIC_RELAXED);
+}
 
-        lua_createtable(L, 0, 0);
-        int table = lua_gettop(L);
+static void luaTable_pushMPPatchTable(lua_State *L) {
+    lua_createtable(L, 0, 0);
+    int table = lua_gettop(L);
 
-        table_setInteger(L, table, "__mppatch_marker", 1);
-        table_setTable(L, table, "version", luaTable_versioninfo);
-        table_setTable(L, table, "NetPatch", luaTable_NetPatch);
-        table_setTable(L, table, "globals", luaTable_globals);
-        table_setTable(L, table, "config", luaTable_config);
-        table_setCFunction(L, table, "debugPrint", luaHook_debugPrint);
-        table_setCFunction(L, table, "getGlobals", luaHook_getGlobals);
-
-        lua_pushGlobals(L);
-        int globals = lua_gettop(L);
-        lua_pushstring(L, "jit");
-        lua_gettable(L, globals);
-        int jit = lua_gettop(L);
-        if(lua_toboolean(L, jit)) {
-            lua_pushstring(L, "luajit_version");
-            lua_pushstring(L, "version");
-            lua_gettable(L, jit);
-            lua_rawset(L, table);
-        }
-        lua_pop(L, 2);
+    table_setInteger(L, table, "__mppatch_marker", 1);
+    table_setTable(L, table, "version", luaTable_versioninfo);
+    table_setTable(L, table, "NetPatch", luaTable_NetPatch);
+    table_setTable(L, table, "ModCodec", luaTable_ModCodec);
+    table_setTable(L, table, "globals", luaTable_globals);
+    table_setTable(L, table, "config", luaTable_config);
+    table_setTable(L, table, "startup", luaTable_startup);
+    table_setTable(L, table, "stats", luaTable_stats);
+    table_setTable(L, table, "profiler", luaTable_profiler);
+    table_setTable(L, table, "jit", luaTable_jit);
+    table_setTable(L, table, "memory", luaTable_memory);
+    table_setTable(L, table, "gc", luaTable_gc);
+    table_setCFunction(L, table, "debugPrint", luaHook_debugPrint);
+    table_setCFunction(L, table, "getGlobals", luaHook_getGlobals);
 
-        lua_pushstring(L, "shared");
-        luaTable_pushSharedState(L);
+    lua_pushGlobals(L);
+    int globals = lua_gettop(L);
+    lua_pushstring(L, "jit");
+    lua_gettable(L, globals);
+    int jit = lua_gettop(L);
+    if(lua_toboolean(L, jit)) {
+        lua_pushstring(L, "luajit_version");
+        lua_pushstring(L, "version");
+        lua_gettable(L, jit);
         lua_rawset(L, table);
+    }
+    lua_pop(L, 2);
+
+    lua_pushstring(L, "shared");
+    luaTable_pushSharedState(L);
+    lua_rawset(L, table);
+}
+static bool luaTable_pushCachedTable(lua_State *L) {
+    int generation = __atomic_load_n(&tableGeneration, __ATOMIC_RELAXED);
 
-        return 1;
+    lua_pushstring(L, LuaTableHook_GENERATION_REGINDEX);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    bool isCurrent = lua_type(L, -1) == LUA_TNUMBER && lua_tointeger(L, -1) == generation;
+    lua_pop(L, 1);
+    if(!isCurrent) return false;
+
+    lua_pushstring(L, LuaTableHook_TABLE_REGINDEX);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    if(lua_type(L, -1) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+static void luaTable_cacheTable(lua_State *L, int table) {
+    lua_pushstring(L, LuaTableHook_TABLE_REGINDEX);
+    lua_pushvalue(L, table);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+
+    lua_pushstring(L, LuaTableHook_GENERATION_REGINDEX);
+    lua_pushinteger(L, __atomic_load_n(&tableGeneration, __ATOMIC_RELAXED));
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+// With enableSamplingProfiler or enableJitDiagnostics, collection starts as soon as the first Lua state asks for the
+// MPPatch table, since LuaJIT needs a lua_State to attach to.
+static bool collectorsStarted = false;
+static void luaTable_startCollectors(lua_State *L) {
+    if(__atomic_exchange_n(&collectorsStarted, true, __ATOMIC_RELAXED)) return;
+    if(enableSamplingProfiler) SamplingProfiler_start(L, samplingIntervalMillis);
+    if(enableJitDiagnostics) JitDiagnostics_attach(L);
+}
+
+// Telemetry reports the Lua memory of every live state as of its last lGetMemoryUsage call. Each state keeps the figure
+// it last added to the total in a userdata in its registry, whose finalizer takes it back out when the state closes.
+static uint64_t luaMemoryKB __attribute__((aligned(8))) = 0;
+static int luaMemory_close(lua_State *L) {
+    uint32_t* reported = lua_touserdata(L, 1);
+    Telemetry_set(TELEMETRY_LUA_MEMORY_KB, __atomic_sub_fetch(&luaMemoryKB, *reported, __ATOMIC_RELAXED));
+    return 0;
+}
+static void luaMemory_publish(lua_State *L) {
+    lua_pushstring(L, LuaTableHook_MEMORY_REGINDEX);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    uint32_t* reported = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if(reported == NULL) {
+        reported = lua_newuserdata(L, sizeof(uint32_t));
+        *reported = 0;
+        lua_createtable(L, 0, 1);
+        lua_pushcfunction(L, luaMemory_close);
+        lua_setfield(L, -2, "__gc");
+        lua_setmetatable(L, -2);
+        lua_setfield(L, LUA_REGISTRYINDEX, LuaTableHook_MEMORY_REGINDEX);
+    }
+
+    uint32_t current = lua_gc(L, LUA_GCCOUNT, 0);
+    uint64_t total = __atomic_add_fetch(&luaMemoryKB, (uint64_t) current - *reported, __ATOMIC_RELAXED);
+    *reported = current;
+    Telemetry_set(TELEMETRY_LUA_MEMORY_KB, total);
+}
+
+lGetMemoryUsage_t lGetMemoryUsage;
+ENTRY lGetMemoryUsage_attributes int lGetMemoryUsageProxy(lua_State *L) {
+    uint64_t startTime = Metrics_begin();
+    if(enableTelemetry) luaMemory_publish(L);
+    int ret;
+    if(lua_type(L, 1) == LUA_TSTRING && !strcmp(luaL_checkstring(L, 1), LuaTableHook_SENTINEL)) {
+        if(luaTable_pushCachedTable(L)) {
+            debug_trace("Found sentinel value, returning cached MPPatch table.")
+        } else {
+            debug_print("Found sentinel value, building MPPatch table.")
+            if(enableLuaAllocator) LuaAllocator_install(L);
+            luaTable_startCollectors(L);
+            luaTable_pushMPPatchTable(L);
+            luaTable_cacheTable(L, lua_gettop(L));
+        }
+        ret = 1;
     } else {
-        debug_print("lGetMemoryUsage called, but sentinel value not found. Calling original function.")
-        return lGetMemoryUsage(L);
+        debug_trace("lGetMemoryUsage called, but sentinel value not found. Calling original function.")
+        ret = lGetMemoryUsage(L);
     }
-}
\ No newline at end of file
+    Metrics_end(HOOK_METRIC_LGETMEMORYUSAGE, startTime);
+    return ret;
+}
@@ -28,3 +28,6 @@
 lGetMemoryUsage_attributes int lGetMemoryUsageProxy(lua_State *L);
 typedef int lGetMemoryUsage_attributes (*lGetMemoryUsage_t)(lua_State *L);
 extern lGetMemoryUsage_t lGetMemoryUsage;
+
+// Makes every lua_State rebuild its cached MPPatch table on its next sentinel call, e.g. after a config change.
+void LuaTableHook_invalidate();
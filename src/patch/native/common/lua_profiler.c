@@ -0,0 +1,155 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "sync.h"
+#include "lua_profiler.h"
+
+#include "lua.h"
+
+lua_pcall_t LuaProfiler_originalPcall;
+lua_call_t  LuaProfiler_originalCall;
+
+// Chunks are kept in an open addressing table keyed by a hash of their source name. When the table is full, further
+// chunks are counted under a single overflow entry.
+typedef struct ChunkEntry {
+    uint32_t hash;
+    bool used;
+    LuaChunkProfile profile;
+} ChunkEntry;
+static ChunkEntry chunks[LUA_PROFILER_MAX_CHUNKS];
+static int chunkCount = 0;
+static LuaChunkProfile overflowChunk = { "<other>" };
+static Mutex profileLock = MUTEX_INITIALIZER;
+
+static uint32_t hashName(const char* name) {
+    uint32_t hash = 2166136261U;
+    for(const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619U;
+    return hash;
+}
+static LuaChunkProfile* findChunk(const char* name) {
+    uint32_t hash = hashName(name);
+    for(uint32_t i=0; i<LUA_PROFILER_MAX_CHUNKS; i++) {
+        ChunkEntry* entry = &chunks[(hash + i) % LUA_PROFILER_MAX_CHUNKS];
+        if(!entry->used) {
+            if(chunkCount >= LUA_PROFILER_MAX_CHUNKS * 3 / 4) return &overflowChunk;
+            entry->used = true;
+            entry->hash = hash;
+            strncpy(entry->profile.name, name, LUA_PROFILER_NAME_LENGTH - 1);
+            chunkCount++;
+            return &entry->profile;
+        }
+        if(entry->hash == hash && !strncmp(entry->profile.name, name, LUA_PROFILER_NAME_LENGTH - 1))
+            return &entry->profile;
+    }
+    return &overflowChunk;
+}
+
+// Nested profiled calls are tracked per thread, to subtract their time from the caller's self time. lua_call may
+// unwind past its caller on an error, so each frame restores the depth it was entered at instead of decrementing it.
+#define MAX_DEPTH 64
+static __thread int callDepth = 0;
+static __thread uint64_t childNanos[MAX_DEPTH];
+
+static int beginCall(lua_State *L, int nargs, lua_Debug* ar) {
+    // lua_getinfo only accepts functions, and pops the copy it is given. Calling anything else is left to lua_call to
+    // report, under a placeholder name.
+    if(lua_type(L, -(nargs + 1)) != LUA_TFUNCTION) strcpy(ar->short_src, "<non-function>");
+    else {
+        lua_pushvalue(L, -(nargs + 1));
+        if(!lua_getinfo(L, ">S", ar)) strcpy(ar->short_src, "<unknown>");
+    }
+
+    int depth = callDepth++;
+    if(depth < MAX_DEPTH) childNanos[depth] = 0;
+    return depth;
+}
+static void endCall(int depth, lua_Debug* ar, uint64_t time) {
+    callDepth = depth;
+    uint64_t children = depth < MAX_DEPTH ? childNanos[depth] : 0;
+    if(depth > 0 && depth <= MAX_DEPTH) childNanos[depth - 1] += time;
+
+    Mutex_lock(&profileLock);
+    LuaChunkProfile* profile = findChunk(ar->short_src);
+    profile->calls++;
+    profile->totalNanos += time;
+    profile->selfNanos  += time > children ? time - children : 0;
+    if(time > profile->maxNanos) profile->maxNanos = time;
+    Mutex_unlock(&profileLock);
+}
+
+ENTRY int LuaProfiler_pcall(lua_State *L, int nargs, int nresults, int errfunc) {
+    lua_Debug ar;
+    int depth = beginCall(L, nargs, &ar);
+    uint64_t startTime = getMonotonicNanos();
+    int ret = LuaProfiler_originalPcall(L, nargs, nresults, errfunc);
+    endCall(depth, &ar, getMonotonicNanos() - startTime);
+    return ret;
+}
+ENTRY void LuaProfiler_call(lua_State *L, int nargs, int nresults) {
+    lua_Debug ar;
+    int depth = beginCall(L, nargs, &ar);
+    uint64_t startTime = getMonotonicNanos();
+    LuaProfiler_originalCall(L, nargs, nresults);
+    endCall(depth, &ar, getMonotonicNanos() - startTime);
+}
+
+static int compareSelfTime(const void* a, const void* b) {
+    uint64_t selfA = ((const LuaChunkProfile*) a)->selfNanos, selfB = ((const LuaChunkProfile*) b)->selfNanos;
+    return selfA < selfB ? 1 : selfA > selfB ? -1 : 0;
+}
+int LuaProfiler_snapshot(LuaChunkProfile* out, int max) {
+    int count = 0;
+    Mutex_lock(&profileLock);
+    for(int i=0; i<LUA_PROFILER_MAX_CHUNKS && count < max; i++)
+        if(chunks[i].used) out[count++] = chunks[i].profile;
+    if(overflowChunk.calls != 0 && count < max) out[count++] = overflowChunk;
+    Mutex_unlock(&profileLock);
+
+    qsort(out, count, sizeof(LuaChunkProfile), compareSelfTime);
+    return count;
+}
+void LuaProfiler_reset() {
+    Mutex_lock(&profileLock);
+    memset(chunks, 0, sizeof(chunks));
+    chunkCount = 0;
+    overflowChunk.calls = 0;
+    overflowChunk.totalNanos = overflowChunk.selfNanos = overflowChunk.maxNanos = 0;
+    Mutex_unlock(&profileLock);
+}
+void LuaProfiler_dump() {
+    LuaChunkProfile* profiles = malloc(sizeof(LuaChunkProfile) * (LUA_PROFILER_MAX_CHUNKS + 1));
+    int count = LuaProfiler_snapshot(profiles, LUA_PROFILER_MAX_CHUNKS + 1);
+
+    debug_print_raw("Lua profile (%d chunks, by self time):", count);
+    for(int i=0; i<count; i++)
+        debug_print_raw(" - %-48s %8u calls, %10llu us self, %10llu us total, %8llu us max", profiles[i].name,
+                        profiles[i].calls, (unsigned long long) profiles[i].selfNanos / 1000,
+                        (unsigned long long) profiles[i].totalNanos / 1000,
+                        (unsigned long long) profiles[i].maxNanos / 1000);
+    free(profiles);
+}
@@ -0,0 +1,54 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "lua.h"
+
+// Per-chunk profiling of Lua calls made by the game through lua_pcall and lua_call, i.e. every UI callback it
+// dispatches. Calls are attributed to the source chunk of the function being called. Self time excludes nested
+// profiled calls.
+#define LUA_PROFILER_MAX_CHUNKS 256
+#define LUA_PROFILER_NAME_LENGTH 64
+
+typedef struct LuaChunkProfile {
+    char name[LUA_PROFILER_NAME_LENGTH];
+    uint32_t calls;
+    uint64_t totalNanos;
+    uint64_t selfNanos;
+    uint64_t maxNanos;
+} LuaChunkProfile;
+
+typedef int  (*lua_pcall_t)(lua_State *L, int nargs, int nresults, int errfunc);
+typedef void (*lua_call_t )(lua_State *L, int nargs, int nresults);
+extern lua_pcall_t LuaProfiler_originalPcall;
+extern lua_call_t  LuaProfiler_originalCall;
+
+int  LuaProfiler_pcall(lua_State *L, int nargs, int nresults, int errfunc);
+void LuaProfiler_call (lua_State *L, int nargs, int nresults);
+
+// Copies up to max chunk profiles, sorted by self time, and returns how many were copied.
+int LuaProfiler_snapshot(LuaChunkProfile* out, int max);
+void LuaProfiler_reset();
+void LuaProfiler_dump();
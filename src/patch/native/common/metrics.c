@@ -0,0 +1,80 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdbool.h>
+
+#include "metrics.h"
+#include "platform.h"
+#include "telemetry.h"
+#include "frame_stats.h"
+
+_Static_assert((int) TELEMETRY_OVERRIDES_APPLIED == (int) HOOK_METRIC_COUNT, "telemetry hook counters out of sync");
+
+static const char* metricNames[HOOK_METRIC_COUNT] = {
+    "lGetMemoryUsage", "SetActiveDLCAndMods", "SetActiveDLCAndMods_original"
+};
+static HookMetrics metrics[HOOK_METRIC_COUNT];
+
+// Counters are updated with relaxed atomics. A snapshot taken during a call may be off by that call, which is fine
+// for statistics.
+uint64_t Metrics_begin() {
+    return getMonotonicNanos();
+}
+void Metrics_end(HookMetric metric, uint64_t startTime) {
+    uint64_t time = getMonotonicNanos() - startTime;
+    HookMetrics* entry = &metrics[metric];
+
+    uint32_t micros = time / 1000 > UINT32_MAX ? UINT32_MAX : time / 1000;
+    int bucket = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+    if(bucket >= METRICS_HISTOGRAM_BUCKETS) bucket = METRICS_HISTOGRAM_BUCKETS - 1;
+
+    __atomic_fetch_add(&entry->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&entry->totalNanos, time, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&entry->histogram[bucket], 1, __ATOMIC_RELAXED);
+    Telemetry_add((TelemetryCounter) metric, 1);
+    FrameStats_chargeHook(metric, time);
+
+    uint64_t max = __atomic_load_n(&entry->maxNanos, __ATOMIC_RELAXED);
+    while(time > max && !__atomic_compare_exchange_n(&entry->maxNanos, &max, time, true,
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+const char* Metrics_name(HookMetric metric) {
+    return metricNames[metric];
+}
+void Metrics_snapshot(HookMetric metric, HookMetrics* out) {
+    HookMetrics* entry = &metrics[metric];
+    out->calls      = __atomic_load_n(&entry->calls     , __ATOMIC_RELAXED);
+    out->totalNanos = __atomic_load_n(&entry->totalNanos, __ATOMIC_RELAXED);
+    out->maxNanos   = __atomic_load_n(&entry->maxNanos  , __ATOMIC_RELAXED);
+    for(int i=0; i<METRICS_HISTOGRAM_BUCKETS; i++)
+        out->histogram[i] = __atomic_load_n(&entry->histogram[i], __ATOMIC_RELAXED);
+}
+void Metrics_reset() {
+    for(int metric=0; metric<HOOK_METRIC_COUNT; metric++) {
+        HookMetrics* entry = &metrics[metric];
+        __atomic_store_n(&entry->calls     , 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->totalNanos, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->maxNanos  , 0, __ATOMIC_RELAXED);
+        for(int i=0; i<METRICS_HISTOGRAM_BUCKETS; i++) __atomic_store_n(&entry->histogram[i], 0, __ATOMIC_RELAXED);
+    }
+}
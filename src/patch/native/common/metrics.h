@@ -0,0 +1,51 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Call counters and latency histograms for hooked functions. Histogram bucket 0 counts calls under 1 us, and bucket
+// n counts calls taking [2^(n-1), 2^n) us. The last bucket also takes everything slower.
+#define METRICS_HISTOGRAM_BUCKETS 24
+
+typedef enum HookMetric {
+    HOOK_METRIC_LGETMEMORYUSAGE,
+    HOOK_METRIC_SETACTIVEDLCANDMODS,
+    HOOK_METRIC_SETACTIVEDLCANDMODS_ORIGINAL,
+    HOOK_METRIC_COUNT
+} HookMetric;
+
+// The 64-bit counters are updated atomically, which needs 8 byte alignment on i386, where the ABI only gives 4.
+typedef struct HookMetrics {
+    uint32_t calls;
+    uint64_t totalNanos __attribute__((aligned(8)));
+    uint64_t maxNanos   __attribute__((aligned(8)));
+    uint32_t histogram[METRICS_HISTOGRAM_BUCKETS];
+} HookMetrics;
+
+uint64_t Metrics_begin();
+void Metrics_end(HookMetric metric, uint64_t startTime);
+
+const char* Metrics_name(HookMetric metric);
+void Metrics_snapshot(HookMetric metric, HookMetrics* out);
+void Metrics_reset();
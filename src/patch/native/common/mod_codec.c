@@ -0,0 +1,302 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "mod_codec.h"
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#define ModCodec_NAMES_REGINDEX "2c11892f-7ad1-4ea1-bc4e-770a86c387e6_modcodec_names"
+
+#define ENCODING_VERSION_MAJOR 1
+#define ENCODING_VERSION_MINOR 0
+
+// Option names
+//
+// Every option name is wrapped in "\x13" ... "\x08" (mungeName in the Lua code) to work around a prefix matching bug
+// in CvPreGame. Once built, names are kept in a per-state cache table in the registry, so that encoding or decoding a
+// mod list does not allocate any new strings for them. cache[0] holds the header fields, and cache[id] holds the
+// fields for mod id:
+//
+//   1     = !$id    (version)
+//   2-5   = $i$id   (uuid blocks)
+//   6     = #$id    (name length)
+//   6+$i  = $id~$i  (name data blocks)
+#define HEADER_MAJOR_VERSION 1
+#define HEADER_MINOR_VERSION 2
+#define HEADER_IS_MODDING    3
+#define HEADER_MOD_COUNT     4
+
+#define MOD_VERSION          1
+#define MOD_UUID_BLOCK       2
+#define MOD_NAME_LENGTH      6
+#define MOD_NAME_BLOCK       6
+
+// Decoded option values come from the host's PreGame options, so they are bounded before anything is sized by them.
+#define MAX_MOD_COUNT        1024
+#define MAX_NAME_LENGTH      4096
+
+static const char* headerFields[] = { NULL, "V0", "V1", "?", "#" };
+static const char printableCharacters[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// Base 62, least significant digit first. The v1.0 encoding indexes the most significant digit from 1 rather than
+// 0, so this is not a plain base 62 encoding, and n must not be 0.
+static int encodeNumber(char* out, uint32_t n) {
+    int length = 0;
+    while(n >= 62) {
+        out[length++] = printableCharacters[n % 62];
+        n /= 62;
+    }
+    out[length++] = printableCharacters[n - 1];
+    return length;
+}
+static int buildOptionName(char* out, int id, int slot) {
+    int length = 0;
+    out[length++] = '\x13';
+    if(id == 0) {
+        strcpy(out + length, headerFields[slot]);
+        length += strlen(headerFields[slot]);
+    } else if(slot == MOD_VERSION) {
+        out[length++] = '!';
+        length += encodeNumber(out + length, id);
+    } else if(slot < MOD_NAME_LENGTH) {
+        out[length++] = '0' + (slot - MOD_UUID_BLOCK + 1);
+        length += encodeNumber(out + length, id);
+    } else if(slot == MOD_NAME_LENGTH) {
+        out[length++] = '#';
+        length += encodeNumber(out + length, id);
+    } else {
+        length += encodeNumber(out + length, id);
+        out[length++] = '~';
+        length += encodeNumber(out + length, slot - MOD_NAME_BLOCK);
+    }
+    out[length++] = '\x08';
+    return length;
+}
+
+static int pushNameCache(lua_State *L) {
+    lua_pushstring(L, ModCodec_NAMES_REGINDEX);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    if(lua_type(L, -1) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 0);
+        lua_pushstring(L, ModCodec_NAMES_REGINDEX);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+    return lua_gettop(L);
+}
+static int pushIdCache(lua_State *L, int cache, int id) {
+    lua_rawgeti(L, cache, id);
+    if(lua_type(L, -1) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        lua_createtable(L, id == 0 ? 4 : 8, 0);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, cache, id);
+    }
+    return lua_gettop(L);
+}
+static void pushOptionName(lua_State *L, int idCache, int id, int slot) {
+    lua_rawgeti(L, idCache, slot);
+    if(lua_type(L, -1) != LUA_TSTRING) {
+        lua_pop(L, 1);
+
+        char buffer[32];
+        lua_pushlstring(L, buffer, buildOptionName(buffer, id, slot));
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, idCache, slot);
+    }
+}
+
+// Option values are signed 32-bit integers in CvPreGame, but unsigned in the Lua code.
+static int32_t encode32(lua_Number value) {
+    if(value > 0x7FFFFFFF) value -= 4294967296.0;
+    return (int32_t) value;
+}
+
+// Encoding
+typedef struct OptionWriter {
+    lua_State *L;
+    int output;
+    int index;
+} OptionWriter;
+static void writeOption(OptionWriter* writer, int idCache, int id, int slot, int32_t value) {
+    pushOptionName(writer->L, idCache, id, slot);
+    lua_rawseti(writer->L, writer->output, ++writer->index);
+    lua_pushinteger(writer->L, value);
+    lua_rawseti(writer->L, writer->output, ++writer->index);
+}
+
+static bool parseUUID(const char* uuid, uint32_t* blocks) {
+    // Like uuidString:gsub("-", ""):match(uuidRegex), this takes the first run of 32 hex digits, ignoring dashes.
+    char digits[33];
+    int count = 0;
+    for(const char* c = uuid; *c; c++) {
+        if(*c == '-') continue;
+        bool isHex = (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f') || (*c >= 'A' && *c <= 'F');
+        if(!isHex) {
+            count = 0;
+            continue;
+        }
+        digits[count++] = *c;
+        if(count == 32) break;
+    }
+    if(count != 32) return false;
+
+    for(int i=0; i<4; i++) {
+        char block[9];
+        memcpy(block, digits + i * 8, 8);
+        block[8] = '\0';
+        blocks[i] = strtoul(block, NULL, 16);
+    }
+    return true;
+}
+
+static void encodeMod(OptionWriter* writer, int cache, int id, int mod) {
+    lua_State *L = writer->L;
+    int idCache = pushIdCache(L, cache, id);
+
+    lua_getfield(L, mod, "ID");
+    lua_getfield(L, mod, "Version");
+    lua_getfield(L, mod, "Name");
+    if(lua_type(L, -3) != LUA_TSTRING || !lua_isnumber(L, -2) || lua_type(L, -1) != LUA_TSTRING)
+        luaL_error(L, "invalid mod record at index %d", id);
+
+    uint32_t uuid[4];
+    if(!parseUUID(lua_tostring(L, -3), uuid)) luaL_error(L, "could not parse UUID");
+
+    writeOption(writer, idCache, id, MOD_VERSION, encode32(lua_tonumber(L, -2)));
+    for(int i=0; i<4; i++) writeOption(writer, idCache, id, MOD_UUID_BLOCK + i, (int32_t) uuid[i]);
+
+    size_t length;
+    const uint8_t* name = (const uint8_t*) lua_tolstring(L, -1, &length);
+    writeOption(writer, idCache, id, MOD_NAME_LENGTH, length);
+    for(size_t i=0; i<length; i+=4) {
+        uint32_t block = 0;
+        for(size_t j=i; j<i+4; j++) block = (block << 8) | (j < length ? name[j] : 0);
+        writeOption(writer, idCache, id, MOD_NAME_BLOCK + 1 + i / 4, (int32_t) block);
+    }
+
+    lua_pop(L, 4);
+}
+
+int ModCodec_encodeModsList(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int count = lua_objlen(L, 1);
+
+    int cache = pushNameCache(L);
+    int headerCache = pushIdCache(L, cache, 0);
+    lua_createtable(L, count * 16 + 8, 0);
+    OptionWriter writer = { L, lua_gettop(L), 0 };
+
+    writeOption(&writer, headerCache, 0, HEADER_MAJOR_VERSION, ENCODING_VERSION_MAJOR);
+    writeOption(&writer, headerCache, 0, HEADER_MINOR_VERSION, ENCODING_VERSION_MINOR);
+    writeOption(&writer, headerCache, 0, HEADER_IS_MODDING, count > 0);
+    if(count > 0) {
+        writeOption(&writer, headerCache, 0, HEADER_MOD_COUNT, count);
+        for(int i=1; i<=count; i++) {
+            lua_rawgeti(L, 1, i);
+            if(lua_type(L, -1) != LUA_TTABLE) return luaL_error(L, "invalid mod record at index %d", i);
+            encodeMod(&writer, cache, i, lua_gettop(L));
+            lua_pop(L, 1);
+        }
+    }
+    return 1;
+}
+
+// Decoding
+static uint32_t readOption(lua_State *L, int idCache, int id, int slot) {
+    lua_pushvalue(L, 1);
+    pushOptionName(L, idCache, id, slot);
+    lua_call(L, 1, 1);
+    if(!lua_isnumber(L, -1)) {
+        char buffer[32];
+        buffer[buildOptionName(buffer, id, slot) - 1] = '\0';
+        luaL_error(L, "missing game option %s", buffer + 1);
+    }
+    uint32_t value = (uint32_t) encode32(lua_tonumber(L, -1));
+    lua_pop(L, 1);
+    return value;
+}
+
+static void decodeMod(lua_State *L, int cache, int id) {
+    int idCache = pushIdCache(L, cache, id);
+    lua_createtable(L, 0, 3);
+    int mod = lua_gettop(L);
+
+    uint32_t uuid[4];
+    for(int i=0; i<4; i++) uuid[i] = readOption(L, idCache, id, MOD_UUID_BLOCK + i);
+    char uuidString[40];
+    snprintf(uuidString, sizeof(uuidString), "%08x-%04x-%04x-%04x-%04x%08x",
+             uuid[0], uuid[1] >> 16, uuid[1] & 0xFFFF, uuid[2] >> 16, uuid[2] & 0xFFFF, uuid[3]);
+    lua_pushstring(L, uuidString);
+    lua_setfield(L, mod, "ID");
+
+    lua_pushnumber(L, readOption(L, idCache, id, MOD_VERSION));
+    lua_setfield(L, mod, "Version");
+
+    uint32_t length = readOption(L, idCache, id, MOD_NAME_LENGTH);
+    if(length > MAX_NAME_LENGTH) luaL_error(L, "invalid name length %f for mod %d", (lua_Number) length, id);
+    uint8_t* name = lua_newuserdata(L, (size_t) length + 4);
+    for(uint32_t i=0; i<length; i+=4) {
+        uint32_t block = readOption(L, idCache, id, MOD_NAME_BLOCK + 1 + i / 4);
+        for(int j=0; j<4; j++) name[i + j] = block >> (24 - j * 8);
+    }
+    lua_pushlstring(L, (const char*) name, length);
+    lua_setfield(L, mod, "Name");
+    lua_pop(L, 1);
+
+    lua_remove(L, idCache);
+}
+
+int ModCodec_decodeModsList(lua_State *L) {
+    luaL_checkany(L, 1);
+    int cache = pushNameCache(L);
+    int headerCache = pushIdCache(L, cache, 0);
+
+    lua_pushvalue(L, 1);
+    pushOptionName(L, headerCache, 0, HEADER_IS_MODDING);
+    lua_call(L, 1, 1);
+    bool isModding = lua_isnumber(L, -1) && lua_tonumber(L, -1) == 1;
+    lua_pop(L, 1);
+    if(!isModding) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    uint32_t count = readOption(L, headerCache, 0, HEADER_MOD_COUNT);
+    if(count > MAX_MOD_COUNT) return luaL_error(L, "invalid mod count %f", (lua_Number) count);
+    lua_createtable(L, count, 0);
+    int list = lua_gettop(L);
+    for(int i=1; i<=(int) count; i++) {
+        decodeMod(L, cache, i);
+        lua_rawseti(L, list, i);
+    }
+    return 1;
+}
@@ -0,0 +1,36 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include "lua.h"
+
+// Native implementation of the v1.0 PreGame mod list encoding from mppatch_serialize.lua. The encoding is part of the
+// network protocol and of saved games, so the output must stay byte-for-byte identical to the Lua implementation.
+
+// encodeModsList({ {ID=..., Version=..., Name=...}, ... }) returns a flat array of option names and their int32
+// values: { name1, value1, name2, value2, ... }
+int ModCodec_encodeModsList(lua_State *L);
+
+// decodeModsList(getGameOption) reads the mod list back, calling getGameOption with each option name. Returns nil if
+// the game is not modded.
+int ModCodec_decodeModsList(lua_State *L);
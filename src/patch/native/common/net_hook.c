@@ -28,26 +28,17 @@
 #include "c_rt.h"
 #include "platform.h"
 #include "net_hook.h"
+#include "metrics.h"
+#include "config.h"
+#include "telemetry.h"
 
-static bool installLock = false;
-#define spinUnlock() while(!__sync_bool_compare_and_swap(&installLock, true, false));
-#define spinLock()   while(!__sync_bool_compare_and_swap(&installLock, false, true));
-
-typedef struct GUID {
-    uint32_t data1;
-    uint16_t data2;
-    uint16_t data3;
-    uint64_t data4;
-} GUID;
-typedef struct ModInfo {
-    char modId[64];
-    int version;
-} ModInfo;
+static Mutex installLock = MUTEX_INITIALIZER;
 
 static CppList* overrideDLCList = NULL;
 static CppList* overrideModList = NULL;
 static bool overrideDLCActive  = false, overrideReloadDLC  = false, reloadDLC ;
 static bool overrideModsActive = false, overrideReloadMods = false, reloadMods;
+static bool allowReloadSkip    = false;
 __attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void initNetHook() {
     overrideDLCList = CppList_alloc();
     overrideModList = CppList_alloc();
@@ -59,6 +50,13 @@ void NetPatch_pushMod(const char* modId, int version) {
     info->modId[63] = '\0';
     info->version = version;
 }
+void NetPatch_pushMods(const ModInfo* mods, int count) {
+    CppListLink_reserve(sizeof(ModInfo), count);
+    for(int i=0; i<count; i++) {
+        ModInfo* info = (ModInfo*) CppList_newLink(overrideModList, sizeof(ModInfo));
+        memcpy(info, &mods[i], sizeof(ModInfo));
+    }
+}
 void NetPatch_overrideReloadMods(bool val) {
     overrideReloadMods = true;
     reloadMods = val;
@@ -74,6 +72,41 @@ void NetPatch_pushDLC(uint32_t data1, uint16_t data2, uint16_t data3, uint64_t d
     guid->data3 = data3;
     guid->data4 = data4;
 }
+void NetPatch_pushDLCs(const GUID* guids, int count) {
+    CppListLink_reserve(sizeof(GUID), count);
+    for(int i=0; i<count; i++) {
+        GUID* guid = (GUID*) CppList_newLink(overrideDLCList, sizeof(GUID));
+        memcpy(guid, &guids[i], sizeof(GUID));
+    }
+}
+
+// Parses a GUID in the usual text form. Braces and dashes are ignored, so both "{01234567-89ab-...}" and the dashless
+// form used by _mpPatch.normalizeDlcName are accepted.
+static int hexDigitValue(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+bool NetPatch_parseGUID(const char* str, GUID* out) {
+    uint8_t bytes[16];
+    int digits = 0;
+    for(const char* c = str; *c; c++) {
+        if(*c == '-' || *c == '{' || *c == '}') continue;
+        int value = hexDigitValue(*c);
+        if(value < 0 || digits == 32) return false;
+        if(digits % 2 == 0) bytes[digits / 2] = value << 4;
+        else bytes[digits / 2] |= value;
+        digits++;
+    }
+    if(digits != 32) return false;
+
+    out->data1 = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    out->data2 = (bytes[4] << 8) | bytes[5];
+    out->data3 = (bytes[6] << 8) | bytes[7];
+    memcpy(&out->data4, bytes + 8, 8); // stored in byte order, as in the Windows GUID structure
+    return true;
+}
 void NetPatch_overrideReloadDLC(bool val) {
     overrideReloadDLC = true;
     reloadDLC = val;
@@ -81,11 +114,172 @@ void NetPatch_overrideReloadDLC(bool val) {
 void NetPatch_overrideDLCList() {
     overrideDLCActive = true;
 }
+void NetPatch_allowReloadSkip(bool val) {
+    allowReloadSkip = val;
+}
+
+// List fingerprints
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME        0x100000001b3ULL
+static uint64_t fingerprintBytes(uint64_t hash, const void* data, size_t length) {
+    for(size_t i=0; i<length; i++) hash = (hash ^ ((const uint8_t*) data)[i]) * FNV_PRIME;
+    return hash;
+}
+static uint64_t fingerprintDLCList(uint64_t hash, CppList* list) {
+    for(CppListLink* i = CppList_begin(list); i != CppList_end(list); i = i->next) {
+        GUID* guid = (GUID*) i->data;
+        hash = fingerprintBytes(hash, &guid->data1, sizeof(guid->data1));
+        hash = fingerprintBytes(hash, &guid->data2, sizeof(guid->data2));
+        hash = fingerprintBytes(hash, &guid->data3, sizeof(guid->data3));
+        hash = fingerprintBytes(hash, &guid->data4, sizeof(guid->data4));
+    }
+    return hash;
+}
+static uint64_t fingerprintModList(uint64_t hash, CppList* list) {
+    for(CppListLink* i = CppList_begin(list); i != CppList_end(list); i = i->next) {
+        ModInfo* mod = (ModInfo*) i->data;
+        hash = fingerprintBytes(hash, mod->modId, strnlen(mod->modId, sizeof(mod->modId)) + 1);
+        hash = fingerprintBytes(hash, &mod->version, sizeof(mod->version));
+    }
+    return hash;
+}
+
+// Armed overrides
+//
+// NetPatch_install copies the staged overrides into a NetOverride and publishes it with a single atomic exchange. The
+// proxy takes the armed descriptor, so each install applies to exactly one SetActiveDLCAndMods call.
+//
+// Lobbies re-install the same lists over and over, so the lists are reference counted, and the proxy keeps the last
+// DLC and mod lists it applied. A staged list with the same contents as the applied one shares it instead of being
+// copied again.
+//
+// With enablePermanentNetHook, the hook is installed once at startup instead of being patched in by every install and
+// out again by the proxy, and calls with nothing armed go straight to the original function.
+typedef struct SharedList {
+    CppList* list;
+    uint64_t fingerprint;
+    int refs;
+} SharedList;
+typedef struct NetOverride {
+    SharedList* dlcList;
+    SharedList* modList;
+    bool overrideReloadDLC , reloadDLC ;
+    bool overrideReloadMods, reloadMods;
+    bool allowReloadSkip;
+} NetOverride;
+static NetOverride* armedOverride = NULL;
+static SharedList* appliedDLCList = NULL; // guarded by installLock
+static SharedList* appliedModList = NULL;
+
+// Reload statistics are written by the proxy and by installs, and read from Lua on other threads.
+static ReloadStats reloadStats;
+static Mutex statsLock = MUTEX_INITIALIZER;
+
+static SharedList* SharedList_retain(SharedList* list) {
+    if(list != NULL) __atomic_add_fetch(&list->refs, 1, __ATOMIC_RELAXED);
+    return list;
+}
+static void SharedList_release(SharedList* list) {
+    if(list == NULL || __atomic_sub_fetch(&list->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    CppList_free(list->list);
+    free(list);
+}
+// The fingerprint only rules lists out quickly. Lists are compared entry by entry before one is shared, since handing
+// the game the wrong list on a collision would silently load the wrong mods.
+static bool listsEqual(CppList* a, CppList* b, int length) {
+    if(CppList_size(a) != CppList_size(b)) return false;
+    for(CppListLink *i = CppList_begin(a), *j = CppList_begin(b); i != CppList_end(a); i = i->next, j = j->next)
+        if(memcmp(i->data, j->data, length)) return false;
+    return true;
+}
+static SharedList* snapshotList(CppList* list, int length, SharedList* applied, uint64_t fingerprint) {
+    if(applied != NULL && applied->fingerprint == fingerprint && listsEqual(applied->list, list, length)) {
+        Mutex_lock(&statsLock);
+        reloadStats.listsReused++;
+        Mutex_unlock(&statsLock);
+        return SharedList_retain(applied);
+    }
+
+    SharedList* copy = malloc(sizeof(SharedList));
+    copy->list = CppList_alloc();
+    copy->fingerprint = fingerprint;
+    copy->refs = 1;
+    CppListLink_reserve(length, CppList_size(list));
+    for(CppListLink* i = CppList_begin(list); i != CppList_end(list); i = i->next)
+        memcpy(CppList_newLink(copy->list, length), i->data, length);
+    Mutex_lock(&statsLock);
+    reloadStats.listsCopied++;
+    Mutex_unlock(&statsLock);
+    return copy;
+}
+static NetOverride* NetOverride_snapshot() {
+    NetOverride* override = malloc(sizeof(NetOverride));
+    Mutex_lock(&installLock);
+    if(overrideDLCActive) {
+        uint64_t fingerprint = fingerprintDLCList(FNV_OFFSET_BASIS, overrideDLCList);
+        override->dlcList = snapshotList(overrideDLCList, sizeof(GUID), appliedDLCList, fingerprint);
+    } else override->dlcList = NULL;
+    if(overrideModsActive) {
+        uint64_t fingerprint = fingerprintModList(FNV_OFFSET_BASIS, overrideModList);
+        override->modList = snapshotList(overrideModList, sizeof(ModInfo), appliedModList, fingerprint);
+    } else override->modList = NULL;
+    Mutex_unlock(&installLock);
+    override->overrideReloadDLC  = overrideReloadDLC;
+    override->reloadDLC          = reloadDLC;
+    override->overrideReloadMods = overrideReloadMods;
+    override->reloadMods         = reloadMods;
+    override->allowReloadSkip    = allowReloadSkip;
+    return override;
+}
+static void NetOverride_free(NetOverride* override) {
+    if(override == NULL) return;
+    SharedList_release(override->dlcList);
+    SharedList_release(override->modList);
+    free(override);
+}
+static void NetOverride_arm(NetOverride* override) {
+    NetOverride_free(__atomic_exchange_n(&armedOverride, override, __ATOMIC_ACQ_REL));
+}
+// Remembers the lists of an override the proxy just applied, so that later installs of the same lists can share them.
+static void NetOverride_keepApplied(NetOverride* override) {
+    Mutex_lock(&installLock);
+    if(override->dlcList != NULL && override->dlcList != appliedDLCList) {
+        SharedList_release(appliedDLCList);
+        appliedDLCList = SharedList_retain(override->dlcList);
+    }
+    if(override->modList != NULL && override->modList != appliedModList) {
+        SharedList_release(appliedModList);
+        appliedModList = SharedList_retain(override->modList);
+    }
+    Mutex_unlock(&installLock);
+}
+
+__attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installPermanentNetHook() {
+    if(enableMultiplayerPatch && enablePermanentNetHook) {
+        debug_print("Installing permanent SetActiveDLCAndMods hook.");
+        installNetHook(startupPatches);
+    }
+}
 
 void NetPatch_install() {
-    spinLock();
-    if(SetActiveDLCAndMods_patchInfo == 0) installNetHook();
-    spinUnlock();
+    NetOverride_arm(NetOverride_snapshot());
+    if(enablePermanentNetHook) return;
+
+    Mutex_lock(&installLock);
+    if(SetActiveDLCAndMods_patchInfo == 0) {
+        PatchTransaction* transaction = PatchTransaction_begin("SetActiveDLCAndMods");
+        installNetHook(transaction);
+        PatchTransaction_commit(transaction);
+    }
+    Mutex_unlock(&installLock);
+}
+
+bool NetPatch_isArmed() {
+    return __atomic_load_n(&armedOverride, __ATOMIC_ACQUIRE) != NULL;
+}
+
+void NetPatch_getLockStats(MutexStats* stats) {
+    Mutex_getStats(&installLock, stats);
 }
 
 void NetPatch_reset() {
@@ -93,15 +287,18 @@ void NetPatch_reset() {
     overrideModsActive = false;
     overrideReloadDLC  = false;
     overrideReloadMods = false;
+    allowReloadSkip    = false;
     CppList_clear(overrideDLCList);
     CppList_clear(overrideModList);
+    NetOverride_arm(NULL);
+    if(enablePermanentNetHook) return;
 
-    spinLock();
+    Mutex_lock(&installLock);
     if(SetActiveDLCAndMods_patchInfo != 0) {
         unpatch(SetActiveDLCAndMods_patchInfo);
         SetActiveDLCAndMods_patchInfo = 0;
     }
-    spinUnlock();
+    Mutex_unlock(&installLock);
 }
 
 static void printGUID(void* ptr) {
@@ -118,6 +315,7 @@ static void printMod(void* ptr) {
     debug_print_raw(" - {id = \"%s\", version = %d}", m->modId, m->version);
 }
 static void debugPrintList(CppList* list, const char* header, void (*printFn)(void*)) {
+    if(!debugLog_isEnabled(LOG_LEVEL_DEBUG)) return;
     if(list == NULL) { debug_print_raw("%s (is null)", header); }
     else {
         debug_print_raw("%s (stored length: %d):", header, CppList_size(list));
@@ -126,41 +324,134 @@ static void debugPrintList(CppList* list, const char* header, void (*printFn)(vo
     }
 }
 
+// Redundant reload detection
+//
+// Forcing a reload re-parses the database and reloads every mod, even if the DLC and mod lists are the same as the
+// ones already active. The proxy keeps a fingerprint of the lists the database was last loaded for, and when an install
+// opts in with allowReloadSkip, a reload of the same lists is downgraded to a plain call. Calls that do not reload leave
+// the fingerprint alone, since the database still matches the lists of the last reload.
+//
+// This is only safe if the proxy sees every call, so the fingerprint is only kept with enablePermanentNetHook, and is
+// dropped whenever a call takes the fast path. disableReloadSkip turns this off entirely, in case the database ends
+// up out of sync with the active mod list (see modsbrowser_forcereload.lua).
+static uint64_t lastFingerprint;
+static bool lastFingerprintValid = false;
+
+static uint64_t fingerprintLists(CppList* dlcList, CppList* modList) {
+    uint64_t hash = fingerprintDLCList(FNV_OFFSET_BASIS, dlcList);
+    hash = fingerprintBytes(hash, "|", 1);
+    return fingerprintModList(hash, modList);
+}
+static ReloadDecision decideReload(NetOverride* override, bool reloadRequested, uint64_t fingerprint) {
+    if(!reloadRequested) return RELOAD_NOT_REQUESTED;
+    if(disableReloadSkip || override == NULL || !override->allowReloadSkip) return RELOAD_NOT_ALLOWED;
+    if(!lastFingerprintValid) return RELOAD_UNKNOWN_SET;
+    if(fingerprint != lastFingerprint) return RELOAD_CHANGED_SET;
+    return RELOAD_SKIPPED;
+}
+
+static const char* reloadDecisionNames[] = {
+    "notRequested", "notAllowed", "unknownSet", "changedSet", "skipped"
+};
+const char* NetPatch_reloadDecisionName(ReloadDecision decision) {
+    return reloadDecisionNames[decision];
+}
+void NetPatch_getReloadStats(ReloadStats* stats) {
+    Mutex_lock(&statsLock);
+    *stats = reloadStats;
+    Mutex_unlock(&statsLock);
+}
+
 SetActiveDLCAndMods_t SetActiveDLCAndMods;
 ENTRY int SetActiveDLCAndMods_attributes SetActiveDLCAndModsProxy(void* this, CppList* dlcList, CppList* modList,
                                                                   char pReloadDlc, char pReloadMods) {
-    spinLock();
-    PatchInformation* patchInfo = SetActiveDLCAndMods_patchInfo;
-    unpatchCode(SetActiveDLCAndMods_patchInfo);
-    SetActiveDLCAndMods_patchInfo = 0;
-    spinUnlock();
+    if(enablePermanentNetHook && __atomic_load_n(&armedOverride, __ATOMIC_RELAXED) == NULL) {
+        lastFingerprintValid = false;
+        return SetActiveDLCAndMods(this, dlcList, modList, pReloadDlc, pReloadMods);
+    }
+
+    uint64_t startTime = Metrics_begin();
+    PatchInformation* patchInfo = NULL;
+    if(!enablePermanentNetHook) {
+        Mutex_lock(&installLock);
+        patchInfo = SetActiveDLCAndMods_patchInfo;
+        unpatchCode(SetActiveDLCAndMods_patchInfo);
+        SetActiveDLCAndMods_patchInfo = 0;
+        Mutex_unlock(&installLock);
+    }
+    NetOverride* override = __atomic_exchange_n(&armedOverride, NULL, __ATOMIC_ACQUIRE);
 
     debug_print("In SetActiveDLCAndModsProxy. (this = %p, reloadDlc = %d, reloadMods = %d)",
                 this, pReloadDlc, pReloadMods)
     debugPrintList(dlcList, "Original DLC GUID List", printGUID);
     debugPrintList(modList, "Original Mod List", printMod);
 
-    if(overrideDLCActive ) {
-        debug_print("Overriding DLC list.")
-        debugPrintList(overrideDLCList, "Override DLC List", printGUID);
-        dlcList = overrideDLCList;
-    }
-    if(overrideModsActive) {
-        debug_print("Overriding mods list.")
-        debugPrintList(overrideModList, "Override Mod List", printMod);
-        modList = overrideModList;
+    if(override != NULL) {
+        Telemetry_add(TELEMETRY_OVERRIDES_APPLIED, 1);
+        if(override->dlcList != NULL) {
+            debug_print("Overriding DLC list.")
+            debugPrintList(override->dlcList->list, "Override DLC List", printGUID);
+            dlcList = override->dlcList->list;
+        }
+        if(override->modList != NULL) {
+            debug_print("Overriding mods list.")
+            debugPrintList(override->modList->list, "Override Mod List", printMod);
+            modList = override->modList->list;
+        }
+        if(override->overrideReloadDLC ) {
+            debug_print("Overriding reload DLCs flag (new value: %s)", override->reloadDLC ? "true" : "false")
+            pReloadDlc  = override->reloadDLC;
+        }
+        if(override->overrideReloadMods) {
+            debug_print("Overriding reload mods flag (new value: %s)", override->reloadMods ? "true" : "false")
+            pReloadMods = override->reloadMods;
+        }
     }
-    if(overrideReloadDLC ) {
-        debug_print("Overriding reload DLCs flag (new value: %s)", reloadDLC ? "true" : "false")
-        pReloadDlc  = reloadDLC;
+
+    uint64_t fingerprint = fingerprintLists(dlcList, modList);
+    ReloadDecision decision = decideReload(override, pReloadDlc || pReloadMods, fingerprint);
+    Mutex_lock(&statsLock);
+    reloadStats.lastDecision = decision;
+    if(decision == RELOAD_SKIPPED) {
+        reloadStats.skipped++;
+        if(reloadStats.reloads != 0) reloadStats.savedNanos += reloadStats.reloadNanos / reloadStats.reloads;
     }
-    if(overrideReloadMods) {
-        debug_print("Overriding reload mods flag (new value: %s)", reloadMods ? "true" : "false")
-        pReloadMods = reloadMods;
+    Mutex_unlock(&statsLock);
+    if(decision == RELOAD_SKIPPED) {
+        debug_print("DLC and mod lists match the active set, skipping reload.")
+        pReloadDlc  = 0;
+        pReloadMods = 0;
+        Telemetry_add(TELEMETRY_RELOADS_SKIPPED, 1);
     }
 
+    uint64_t originalStartTime = Metrics_begin();
     int ret = SetActiveDLCAndMods(this, dlcList, modList, pReloadDlc, pReloadMods);
-    free(patchInfo);
+    Metrics_end(HOOK_METRIC_SETACTIVEDLCANDMODS_ORIGINAL, originalStartTime);
+
+    bool reloaded = pReloadDlc || pReloadMods;
+    if(reloaded) {
+        uint64_t reloadTime = getMonotonicNanos() - originalStartTime;
+        Mutex_lock(&statsLock);
+        reloadStats.reloads++;
+        reloadStats.reloadNanos += reloadTime;
+        Mutex_unlock(&statsLock);
+        Telemetry_add(TELEMETRY_RELOADS, 1);
+        Telemetry_add(TELEMETRY_RELOAD_NANOS, reloadTime);
+        Telemetry_set(TELEMETRY_LAST_RELOAD_NANOS, reloadTime);
+    }
+    if(reloaded || decision == RELOAD_SKIPPED) {
+        lastFingerprint      = fingerprint;
+        lastFingerprintValid = enablePermanentNetHook;
+    }
+
+    if(override != NULL) NetOverride_keepApplied(override);
+    NetOverride_free(override);
+    if(patchInfo != NULL) {
+        // The original has returned, so nothing is executing the trampoline anymore.
+        if(patchInfo->functionFragment != NULL) executable_free(patchInfo->functionFragment);
+        free(patchInfo);
+    }
     NetPatch_reset();
+    Metrics_end(HOOK_METRIC_SETACTIVEDLCANDMODS, startTime);
     return ret;
-}
\ No newline at end of file
+}
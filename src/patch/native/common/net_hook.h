@@ -24,17 +24,50 @@
 
 #include "c_rt.h"
 #include "platform.h"
+#include "sync.h"
+
+typedef struct GUID {
+    uint32_t data1;
+    uint16_t data2;
+    uint16_t data3;
+    uint64_t data4;
+} GUID;
+typedef struct ModInfo {
+    char modId[64];
+    int version;
+} ModInfo;
 
 void NetPatch_pushMod(const char* modId, int version);
+void NetPatch_pushMods(const ModInfo* mods, int count);
 void NetPatch_overrideReloadMods(bool val);
 void NetPatch_overrideModList();
 
 void NetPatch_pushDLC(uint32_t data1, uint16_t data2, uint16_t data3, uint64_t data4);
+void NetPatch_pushDLCs(const GUID* guids, int count);
+bool NetPatch_parseGUID(const char* str, GUID* out);
 void NetPatch_overrideReloadDLC(bool val);
 void NetPatch_overrideDLCList();
+void NetPatch_allowReloadSkip(bool val);
 
 void NetPatch_install();
 void NetPatch_reset();
+bool NetPatch_isArmed(); // false once the proxy has consumed the last install
+void NetPatch_getLockStats(MutexStats* stats);
+
+typedef enum ReloadDecision {
+    RELOAD_NOT_REQUESTED, RELOAD_NOT_ALLOWED, RELOAD_UNKNOWN_SET, RELOAD_CHANGED_SET, RELOAD_SKIPPED
+} ReloadDecision;
+typedef struct ReloadStats {
+    ReloadDecision lastDecision;
+    uint32_t reloads;
+    uint32_t skipped;
+    uint64_t reloadNanos;
+    uint64_t savedNanos; // estimated from the average reload time
+    uint32_t listsCopied;
+    uint32_t listsReused; // staged lists that matched the last applied list, and were not copied
+} ReloadStats;
+const char* NetPatch_reloadDecisionName(ReloadDecision decision);
+void NetPatch_getReloadStats(ReloadStats* stats);
 
 
 ENTRY int SetActiveDLCAndMods_attributes SetActiveDLCAndModsProxy(void* this, CppList* dlcList, CppList* modList,
@@ -43,4 +76,4 @@ typedef int SetActiveDLCAndMods_attributes (*SetActiveDLCAndMods_t)(void*, CppLi
 extern PatchInformation* SetActiveDLCAndMods_patchInfo;
 extern SetActiveDLCAndMods_t SetActiveDLCAndMods;
 
-void installNetHook();
+void installNetHook(PatchTransaction* transaction);
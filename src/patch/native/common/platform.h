@@ -23,6 +23,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "platform_defines.h"
 
@@ -48,6 +49,24 @@ ExecutableMemory* executable_malloc(int length);
 void executable_prepare(ExecutableMemory* memory);
 void executable_free(ExecutableMemory* memory);
 
+// Allocates zeroed memory aligned to its own size, which must be a power of two multiple of the page size. Returns NULL
+// on failure.
+void* allocateAlignedMemory(size_t size);
+
+// Threading functions
+void startThread(void (*fn)(void*), void* arg);
+void sleepMilliseconds(int ms);
+uint64_t getMonotonicNanos();
+
+// Sleeps while *address == expected, and may return spuriously. Platforms without a futex just yield.
+void waitOnAddress(volatile int* address, int expected);
+void wakeAddress(volatile int* address);
+
+// Process functions
+uint32_t getProcessId();
+// Maps a file shared with other processes, creating or resizing it as needed. Returns NULL on failure.
+void* mapSharedFile(const char* path, size_t size);
+
 // std::list implementation
 CppList* CppList_alloc();
 void* CppList_newLink(CppList* list, int length);
@@ -0,0 +1,210 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "sync.h"
+#include "sampling_profiler.h"
+
+// These are declared in luajit.h, which is not available since the game's headers are for Lua 5.1.
+typedef void (*luaJIT_profile_callback)(void *data, lua_State *L, int samples, int vmstate);
+typedef void (*luaJIT_profile_start_t)(lua_State *L, const char *mode, luaJIT_profile_callback cb, void *data);
+typedef void (*luaJIT_profile_stop_t)(lua_State *L);
+typedef const char* (*luaJIT_profile_dumpstack_t)(lua_State *L, const char *fmt, int depth, size_t *len);
+
+static luaJIT_profile_start_t     profile_start;
+static luaJIT_profile_stop_t      profile_stop;
+static luaJIT_profile_dumpstack_t profile_dumpstack;
+
+#define MAX_STACK_DEPTH 64
+#define MAX_CONTEXT_LENGTH 64
+
+typedef struct StackEntry {
+    uint32_t hash;
+    uint32_t samples;
+    char* stack;
+} StackEntry;
+static StackEntry stacks[SAMPLING_PROFILER_MAX_STACKS];
+static SamplingProfilerStats profilerStats;
+static Mutex profilerLock = MUTEX_INITIALIZER;
+
+static uint32_t hashStack(const char* stack, size_t length) {
+    uint32_t hash = 2166136261U;
+    for(size_t i=0; i<length; i++) hash = (hash ^ (uint8_t) stack[i]) * 16777619U;
+    return hash;
+}
+static void recordStack(const char* stack, size_t length, int samples) {
+    uint32_t hash = hashStack(stack, length);
+
+    Mutex_lock(&profilerLock);
+    profilerStats.samples += samples;
+    for(uint32_t i=0; i<SAMPLING_PROFILER_MAX_STACKS; i++) {
+        StackEntry* entry = &stacks[(hash + i) % SAMPLING_PROFILER_MAX_STACKS];
+        if(entry->stack == NULL) {
+            if(profilerStats.stacks >= SAMPLING_PROFILER_MAX_STACKS * 3 / 4) break;
+            entry->hash    = hash;
+            entry->samples = samples;
+            entry->stack   = malloc(length + 1);
+            memcpy(entry->stack, stack, length);
+            entry->stack[length] = '\0';
+            profilerStats.stacks++;
+            goto done;
+        }
+        if(entry->hash == hash && !strncmp(entry->stack, stack, length) && entry->stack[length] == '\0') {
+            entry->samples += samples;
+            goto done;
+        }
+    }
+    profilerStats.dropped += samples;
+done:
+    Mutex_unlock(&profilerLock);
+}
+
+// The context is the module of the outermost frame, e.g. "InGame" for "InGame:OnUpdate".
+static size_t contextLength(const char* stack, size_t length) {
+    size_t i = 0;
+    while(i < length && i < MAX_CONTEXT_LENGTH - 1 && stack[i] != ':' && stack[i] != ';') i++;
+    return i;
+}
+static const char* vmStateFrame(int vmstate) {
+    switch(vmstate) {
+        case 'C': return "[C]";
+        case 'G': return "[GC]";
+        case 'J': return "[JIT]";
+        default : return NULL;
+    }
+}
+static void sampleCallback(void* data, lua_State *L, int samples, int vmstate) {
+    size_t length;
+    const char* frames = profile_dumpstack(L, "F;", -MAX_STACK_DEPTH, &length);
+    while(length > 0 && frames[length - 1] == ';') length--;
+
+    // Builds "context;frame;...;frame[;vmstate]".
+    char buffer[4096];
+    size_t context = contextLength(frames, length);
+    const char* leaf = vmStateFrame(vmstate);
+    int written = context == 0
+        ? snprintf(buffer, sizeof(buffer), "<none>;%.*s%s%s", (int) length, frames,
+                   leaf && length ? ";" : "", leaf ? leaf : "")
+        : snprintf(buffer, sizeof(buffer), "%.*s;%.*s%s%s", (int) context, frames, (int) length, frames,
+                   leaf ? ";" : "", leaf ? leaf : "");
+    if(written < 0) return;
+    if(written >= sizeof(buffer)) written = sizeof(buffer) - 1;
+    recordStack(buffer, written, samples);
+}
+
+bool SamplingProfiler_start(lua_State *L, int intervalMillis) {
+    if(profile_start == NULL) {
+        profile_start     = (luaJIT_profile_start_t    ) resolveLuaJITSymbol("luaJIT_profile_start"    );
+        profile_stop      = (luaJIT_profile_stop_t     ) resolveLuaJITSymbol("luaJIT_profile_stop"     );
+        profile_dumpstack = (luaJIT_profile_dumpstack_t) resolveLuaJITSymbol("luaJIT_profile_dumpstack");
+    }
+    if(profile_start == NULL || profile_stop == NULL || profile_dumpstack == NULL) {
+        debug_warn("Cannot start the sampling profiler, as LuaJIT is not loaded.");
+        return false;
+    }
+    if(intervalMillis <= 0) intervalMillis = SAMPLING_PROFILER_DEFAULT_INTERVAL;
+
+    char mode[32];
+    snprintf(mode, sizeof(mode), "fi%d", intervalMillis);
+    profile_start(L, mode, sampleCallback, NULL);
+
+    Mutex_lock(&profilerLock);
+    profilerStats.running = true;
+    profilerStats.intervalMillis = intervalMillis;
+    Mutex_unlock(&profilerLock);
+
+    debug_print("Started the sampling profiler. (interval: %d ms)", intervalMillis);
+    return true;
+}
+void SamplingProfiler_stop(lua_State *L) {
+    if(profile_stop == NULL) return;
+    profile_stop(L);
+
+    Mutex_lock(&profilerLock);
+    profilerStats.running = false;
+    uint32_t samples = profilerStats.samples;
+    Mutex_unlock(&profilerLock);
+    debug_print("Stopped the sampling profiler. (%u samples)", samples);
+}
+void SamplingProfiler_reset() {
+    Mutex_lock(&profilerLock);
+    for(int i=0; i<SAMPLING_PROFILER_MAX_STACKS; i++) free(stacks[i].stack);
+    memset(stacks, 0, sizeof(stacks));
+    profilerStats.samples = profilerStats.stacks = profilerStats.dropped = 0;
+    Mutex_unlock(&profilerLock);
+}
+void SamplingProfiler_getStats(SamplingProfilerStats* stats) {
+    Mutex_lock(&profilerLock);
+    *stats = profilerStats;
+    Mutex_unlock(&profilerLock);
+}
+
+static void contextFileName(char* buffer, size_t size, const char* stack, size_t context) {
+    char name[MAX_CONTEXT_LENGTH];
+    for(size_t i=0; i<context; i++) {
+        char c = stack[i];
+        bool isSafe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+        name[i] = isSafe ? c : '_';
+    }
+    name[context] = '\0';
+    snprintf(buffer, size, "%s" PATH_SEPARATOR "mppatch_profile_%s.folded", executable_directory_path, name);
+}
+int SamplingProfiler_dump(const char* context, void (*onFile)(const char* path, void* data), void* data) {
+    int files = 0;
+
+    Mutex_lock(&profilerLock);
+    bool* written = calloc(SAMPLING_PROFILER_MAX_STACKS, sizeof(bool));
+    for(int i=0; i<SAMPLING_PROFILER_MAX_STACKS; i++) if(stacks[i].stack != NULL && !written[i]) {
+        const char* root = stacks[i].stack;
+        size_t rootLength = strchr(root, ';') - root;
+        if(context != NULL && (strlen(context) != rootLength || strncmp(context, root, rootLength))) continue;
+
+        // Every stack belonging to this context is written together, in a single pass over the rest of the table.
+        char path[PATH_MAX];
+        contextFileName(path, sizeof(path), root, rootLength);
+        FILE* file = fopen(path, "w");
+        if(file == NULL) {
+            debug_warn("Could not open profile output %s.", path);
+            continue;
+        }
+        for(int j=i; j<SAMPLING_PROFILER_MAX_STACKS; j++) {
+            const char* stack = stacks[j].stack;
+            if(stack == NULL || written[j] || strncmp(stack, root, rootLength + 1)) continue;
+            fprintf(file, "%s %u\n", stack, stacks[j].samples);
+            written[j] = true;
+        }
+        fclose(file);
+
+        debug_print("Wrote sampled Lua stacks to %s.", path);
+        if(onFile != NULL) onFile(path, data);
+        files++;
+    }
+    free(written);
+    Mutex_unlock(&profilerLock);
+
+    return files;
+}
@@ -0,0 +1,51 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lua.h"
+
+// Samples Lua stacks with LuaJIT's built-in profiler, and aggregates them into flamegraph-compatible folded stacks.
+// Each stack is rooted at the UI context it ran in, which is the module of the outermost Lua function.
+#define SAMPLING_PROFILER_MAX_STACKS 8192
+#define SAMPLING_PROFILER_DEFAULT_INTERVAL 10
+
+typedef struct SamplingProfilerStats {
+    bool running;
+    int intervalMillis;
+    uint32_t samples;
+    uint32_t stacks;
+    uint32_t dropped;
+} SamplingProfilerStats;
+
+// Starts sampling the Lua VM that L belongs to. Returns false if LuaJIT is not loaded.
+bool SamplingProfiler_start(lua_State *L, int intervalMillis);
+void SamplingProfiler_stop(lua_State *L);
+void SamplingProfiler_reset();
+void SamplingProfiler_getStats(SamplingProfilerStats* stats);
+
+// Writes the collected stacks to one mppatch_profile_<context>.folded file per UI context in the support directory,
+// or only the given context if it is not NULL. Calls onFile with the path of every file written.
+int SamplingProfiler_dump(const char* context, void (*onFile)(const char* path, void* data), void* data);
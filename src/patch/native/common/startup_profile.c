@@ -0,0 +1,127 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "c_rt.h"
+#include "platform.h"
+#include "config.h"
+#include "version.h"
+#include "startup_profile.h"
+
+#define STARTUP_PROFILE_FILENAME "mppatch_startup.jsonl"
+#define MAX_STARTUP_PHASES 16
+
+static const char* counterNames[STARTUP_COUNTER_COUNT] = {
+    "symbolsResolved", "jumpsWritten", "protectCalls", "bytesMapped"
+};
+
+static uint32_t counters[STARTUP_COUNTER_COUNT];
+static StartupPhase phases[MAX_STARTUP_PHASES];
+static uint32_t phaseStartCounters[STARTUP_COUNTER_COUNT];
+static int phaseCount = 0;
+
+void StartupProfile_count(StartupCounter counter, uint32_t amount) {
+    __sync_fetch_and_add(&counters[counter], amount);
+}
+const char* StartupProfile_counterName(StartupCounter counter) {
+    return counterNames[counter];
+}
+
+int StartupProfile_phaseCount() {
+    return phaseCount;
+}
+const StartupPhase* StartupProfile_getPhase(int phase) {
+    return &phases[phase];
+}
+uint64_t StartupProfile_totalNanos() {
+    return phaseCount == 0 ? 0 : phases[phaseCount - 1].endNanos - phases[0].startNanos;
+}
+
+static void endPhase(uint64_t time) {
+    if(phaseCount == 0) return;
+    StartupPhase* phase = &phases[phaseCount - 1];
+    phase->endNanos = time;
+    for(int i=0; i<STARTUP_COUNTER_COUNT; i++) phase->counters[i] = counters[i] - phaseStartCounters[i];
+}
+static void beginPhase(const char* name) {
+    uint64_t time = getMonotonicNanos();
+    endPhase(time);
+
+    StartupPhase* phase = &phases[phaseCount++];
+    phase->name = name;
+    phase->startNanos = time;
+    for(int i=0; i<STARTUP_COUNTER_COUNT; i++) phaseStartCounters[i] = counters[i];
+}
+
+// Each phase starts just before the constructors at its priority run.
+#define STARTUP_PHASE(phaseName, priority) \
+    __attribute__((constructor(priority - 1))) static void beginPhase_##phaseName() { beginPhase(#phaseName); }
+STARTUP_PHASE(getExePath     , CONSTRUCTOR_GET_EXE_PATH     )
+STARTUP_PHASE(readConfig     , CONSTRUCTOR_READ_CONFIG      )
+STARTUP_PHASE(logging        , CONSTRUCTOR_LOGGING          )
+STARTUP_PHASE(earlyInit      , CONSTRUCTOR_EARLY_INIT       )
+STARTUP_PHASE(binaryInitEarly, CONSTRUCTOR_BINARY_INIT_EARLY)
+STARTUP_PHASE(binaryInit     , CONSTRUCTOR_BINARY_INIT      )
+STARTUP_PHASE(proxyInit      , CONSTRUCTOR_PROXY_INIT       )
+STARTUP_PHASE(hookInit       , CONSTRUCTOR_HOOK_INIT        )
+STARTUP_PHASE(hookCommit     , CONSTRUCTOR_HOOK_COMMIT      )
+
+static void dumpStartupProfile() {
+    char buffer[PATH_MAX];
+    getSupportFilePath(buffer, STARTUP_PROFILE_FILENAME);
+    FILE* file = fopen(buffer, "a");
+    if(file == NULL) {
+        debug_warn("Could not open startup profile dump file.");
+        return;
+    }
+
+    fprintf(file, "{\"time\":%ld,\"version\":\"%s\",\"platform\":\"%s\",\"sha256\":\"%s\",\"buildId\":\"%s\","
+                  "\"totalMicros\":%llu,\"phases\":[",
+            (long) time(NULL), patchFullVersion, MPPATCH_PLATFORM, MPPATCH_CIV_VERSION, MPPATCH_BUILDID,
+            (unsigned long long) StartupProfile_totalNanos() / 1000);
+    for(int i=0; i<phaseCount; i++) {
+        StartupPhase* phase = &phases[i];
+        fprintf(file, "%s{\"name\":\"%s\",\"startMicros\":%llu,\"durationMicros\":%llu", i == 0 ? "" : ",",
+                phase->name, (unsigned long long) (phase->startNanos - phases[0].startNanos) / 1000,
+                (unsigned long long) (phase->endNanos - phase->startNanos) / 1000);
+        for(int j=0; j<STARTUP_COUNTER_COUNT; j++) fprintf(file, ",\"%s\":%u", counterNames[j], phase->counters[j]);
+        fputs("}", file);
+    }
+    fputs("]}\n", file);
+    fclose(file);
+}
+__attribute__((constructor(CONSTRUCTOR_HOOK_COMMIT + 1))) static void finishStartupProfile() {
+    endPhase(getMonotonicNanos());
+
+    debug_print("Patch startup took %llu us.", (unsigned long long) StartupProfile_totalNanos() / 1000);
+    for(int i=0; i<phaseCount; i++)
+        debug_trace(" - %-16s %8llu us, %u symbols, %u jumps, %u protect calls, %u bytes mapped", phases[i].name,
+                    (unsigned long long) (phases[i].endNanos - phases[i].startNanos) / 1000,
+                    phases[i].counters[STARTUP_COUNTER_SYMBOLS_RESOLVED],
+                    phases[i].counters[STARTUP_COUNTER_JUMPS_WRITTEN],
+                    phases[i].counters[STARTUP_COUNTER_PROTECT_CALLS],
+                    phases[i].counters[STARTUP_COUNTER_BYTES_MAPPED]);
+
+    if(enableStartupProfileDump) dumpStartupProfile();
+}
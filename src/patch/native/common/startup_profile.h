@@ -0,0 +1,47 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Times each constructor phase of the patch's startup, and counts the work done in it.
+typedef enum StartupCounter {
+    STARTUP_COUNTER_SYMBOLS_RESOLVED,
+    STARTUP_COUNTER_JUMPS_WRITTEN,
+    STARTUP_COUNTER_PROTECT_CALLS,
+    STARTUP_COUNTER_BYTES_MAPPED,
+    STARTUP_COUNTER_COUNT
+} StartupCounter;
+
+typedef struct StartupPhase {
+    const char* name;
+    uint64_t startNanos, endNanos;
+    uint32_t counters[STARTUP_COUNTER_COUNT];
+} StartupPhase;
+
+void StartupProfile_count(StartupCounter counter, uint32_t amount);
+const char* StartupProfile_counterName(StartupCounter counter);
+
+int StartupProfile_phaseCount();
+const StartupPhase* StartupProfile_getPhase(int phase);
+uint64_t StartupProfile_totalNanos();
@@ -0,0 +1,67 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include "sync.h"
+#include "platform.h"
+
+// Lock holders never do more than patch a few bytes or relink a list, so a short spin usually outlasts them.
+#define MUTEX_SPIN_COUNT 128
+
+static inline void cpuRelax() {
+    __asm__ __volatile__("pause" ::: "memory");
+}
+
+void Mutex_lock(Mutex* mutex) {
+    int state = __sync_val_compare_and_swap(&mutex->state, 0, 1);
+    if(state != 0) {
+        uint64_t start = getMonotonicNanos();
+
+        for(int i=0; i<MUTEX_SPIN_COUNT && state != 0; i++) {
+            cpuRelax();
+            if(mutex->state == 0) state = __sync_val_compare_and_swap(&mutex->state, 0, 1);
+        }
+        if(state != 0) {
+            // Mark the mutex as having sleepers. We may be the only one, in which case the owner makes one extra
+            // wake call.
+            state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+            while(state != 0) {
+                waitOnAddress(&mutex->state, 2);
+                state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        mutex->stats.contentions++;
+        mutex->stats.waitNanos += getMonotonicNanos() - start;
+    }
+    mutex->stats.acquisitions++;
+}
+void Mutex_unlock(Mutex* mutex) {
+    if(__sync_fetch_and_sub(&mutex->state, 1) != 1) {
+        __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+        wakeAddress(&mutex->state);
+    }
+}
+void Mutex_getStats(Mutex* mutex, MutexStats* stats) {
+    Mutex_lock(mutex);
+    *stats = mutex->stats;
+    Mutex_unlock(mutex);
+}
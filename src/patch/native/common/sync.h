@@ -0,0 +1,43 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// A mutex that spins briefly before sleeping. This is the three-state futex mutex from Drepper's "Futexes Are Tricky":
+// 0 is unlocked, 1 is locked, and 2 is locked with possible sleepers. Platforms without a futex yield instead of
+// sleeping.
+typedef struct MutexStats {
+    uint32_t acquisitions;
+    uint32_t contentions;
+    uint64_t waitNanos;
+} MutexStats;
+typedef struct Mutex {
+    volatile int state;
+    MutexStats stats; // only written while the mutex is held
+} Mutex;
+#define MUTEX_INITIALIZER { 0, { 0, 0, 0 } }
+
+void Mutex_lock(Mutex* mutex);
+void Mutex_unlock(Mutex* mutex);
+void Mutex_getStats(Mutex* mutex, MutexStats* stats);
@@ -0,0 +1,85 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "config.h"
+#include "platform.h"
+#include "sync.h"
+#include "telemetry.h"
+
+static TelemetryPage* page = NULL;
+static Mutex writeLock = MUTEX_INITIALIZER;
+
+__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void initTelemetry() {
+    if(!enableTelemetry) return;
+
+    char buffer[PATH_MAX];
+    getSupportFilePath(buffer, TELEMETRY_FILENAME);
+    TelemetryPage* mapped = mapSharedFile(buffer, sizeof(TelemetryPage));
+    if(mapped == NULL) {
+        debug_warn("Could not map telemetry file %s, telemetry is disabled.", buffer);
+        return;
+    }
+
+    // Readers check the magic last, so a half-initialized page is never accepted.
+    memset(mapped, 0, sizeof(TelemetryPage));
+    mapped->version = TELEMETRY_VERSION;
+    mapped->size    = sizeof(TelemetryPage);
+    mapped->pid     = getProcessId();
+    strncpy(mapped->buildId, MPPATCH_BUILDID, sizeof(mapped->buildId) - 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(mapped->magic, TELEMETRY_MAGIC, sizeof(mapped->magic));
+
+    debug_print("Publishing telemetry to %s", buffer);
+    page = mapped;
+}
+
+// Writers are serialized by writeLock. Fields are still written with atomic stores, since readers copy the page while
+// it is being written, and rely on sequence to discard torn copies.
+static void beginWrite() {
+    Mutex_lock(&writeLock);
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+static void endWrite() {
+    __atomic_store_n(&page->counters[TELEMETRY_LOG_DROPS], debugLog_droppedEntries(), __ATOMIC_RELAXED);
+    __atomic_store_n(&page->updateNanos, getMonotonicNanos(), __ATOMIC_RELAXED);
+    __atomic_store_n(&page->sequence, page->sequence + 1, __ATOMIC_RELEASE);
+    Mutex_unlock(&writeLock);
+}
+
+void Telemetry_add(TelemetryCounter counter, uint64_t amount) {
+    if(page == NULL) return;
+    beginWrite();
+    __atomic_store_n(&page->counters[counter], page->counters[counter] + amount, __ATOMIC_RELAXED);
+    endWrite();
+}
+void Telemetry_set(TelemetryCounter counter, uint64_t value) {
+    if(page == NULL) return;
+    beginWrite();
+    __atomic_store_n(&page->counters[counter], value, __ATOMIC_RELAXED);
+    endWrite();
+}
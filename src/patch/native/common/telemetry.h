@@ -0,0 +1,72 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Live telemetry, published through a memory mapped file for external monitoring tools. See tools/mppatch_telemetry.c
+// for a reader.
+//
+// The layout is fixed, and must be identical on 32-bit and 64-bit readers. Any change to it other than using a
+// reserved counter slot must bump TELEMETRY_VERSION.
+//
+// The page is updated with a seqlock: writers increment sequence to an odd value, update the page, then increment it
+// to an even value again. Readers copy the page, and retry if sequence was odd or changed during the copy.
+#define TELEMETRY_FILENAME "mppatch_telemetry.bin"
+#define TELEMETRY_MAGIC    "MPPTELEM"
+#define TELEMETRY_VERSION  3
+#define TELEMETRY_COUNTER_SLOTS 32
+
+typedef enum TelemetryCounter {
+    // In HookMetric order
+    TELEMETRY_LGETMEMORYUSAGE_CALLS,
+    TELEMETRY_SETACTIVEDLCANDMODS_CALLS,
+    TELEMETRY_SETACTIVEDLCANDMODS_ORIGINAL_CALLS,
+
+    TELEMETRY_OVERRIDES_APPLIED,
+    TELEMETRY_RELOADS,
+    TELEMETRY_RELOADS_SKIPPED,
+    TELEMETRY_RELOAD_NANOS,
+    TELEMETRY_LAST_RELOAD_NANOS,
+    TELEMETRY_LUA_MEMORY_KB, // summed over live Lua states, each as of its last lGetMemoryUsage call
+    TELEMETRY_LOG_DROPS,
+    TELEMETRY_COUNTER_COUNT
+} TelemetryCounter;
+
+typedef struct TelemetryPage {
+    char     magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    volatile uint32_t sequence;
+    char     buildId[40];
+    uint64_t updateNanos;
+    uint64_t counters[TELEMETRY_COUNTER_SLOTS];
+} TelemetryPage;
+_Static_assert(offsetof(TelemetryPage, updateNanos) == 64, "TelemetryPage layout changed");
+_Static_assert(offsetof(TelemetryPage, counters   ) == 72, "TelemetryPage layout changed");
+_Static_assert(TELEMETRY_COUNTER_COUNT <= TELEMETRY_COUNTER_SLOTS, "too many telemetry counters");
+
+void Telemetry_add(TelemetryCounter counter, uint64_t amount);
+void Telemetry_set(TelemetryCounter counter, uint64_t value);
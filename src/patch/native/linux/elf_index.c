@@ -0,0 +1,111 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+
+#include "elf_index.h"
+
+static int findExecutable(struct dl_phdr_info* info, size_t size, void* data) {
+    // The main executable is always reported first.
+    ElfSymbolIndex* index = (ElfSymbolIndex*) data;
+    index->base = info->dlpi_addr;
+
+    const ElfW(Dyn)* dynamic = NULL;
+    for(int i=0; i<info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if(phdr->p_type == PT_DYNAMIC) dynamic = (const ElfW(Dyn)*) (info->dlpi_addr + phdr->p_vaddr);
+        if(phdr->p_type == PT_LOAD && phdr->p_vaddr + phdr->p_memsz > index->imageSize)
+            index->imageSize = phdr->p_vaddr + phdr->p_memsz;
+    }
+    if(dynamic == NULL) return 1;
+
+    for(; dynamic->d_tag != DT_NULL; dynamic++) {
+        // The dynamic linker usually relocates these in place, but not always.
+        ElfW(Addr) addr = dynamic->d_un.d_ptr;
+        if(addr < info->dlpi_addr) addr += info->dlpi_addr;
+
+        switch(dynamic->d_tag) {
+            case DT_SYMTAB  : index->symtab   = (const ElfW(Sym)*) addr; break;
+            case DT_STRTAB  : index->strtab   = (const char*)      addr; break;
+            case DT_GNU_HASH: index->gnuHash  = (const uint32_t*)  addr; break;
+            case DT_HASH    : index->sysvHash = (const uint32_t*)  addr; break;
+        }
+    }
+    return 1;
+}
+
+void ElfSymbolIndex_findExecutable(ElfSymbolIndex* index) {
+    dl_iterate_phdr(findExecutable, index);
+}
+
+static const ElfW(Sym)* gnuHashLookup(const ElfSymbolIndex* index, const char* name) {
+    uint32_t hash = 5381;
+    for(const char* c = name; *c; c++) hash = hash * 33 + (uint8_t) *c;
+
+    uint32_t nbuckets = index->gnuHash[0], symoffset = index->gnuHash[1];
+    uint32_t bloomSize = index->gnuHash[2], bloomShift = index->gnuHash[3];
+    const ElfW(Addr)* bloom = (const ElfW(Addr)*) &index->gnuHash[4];
+    const uint32_t* buckets = (const uint32_t*) &bloom[bloomSize];
+    const uint32_t* chain   = &buckets[nbuckets];
+
+    const int bits = sizeof(ElfW(Addr)) * 8;
+    ElfW(Addr) word = bloom[(hash / bits) % bloomSize];
+    ElfW(Addr) mask = ((ElfW(Addr)) 1 << (hash % bits)) | ((ElfW(Addr)) 1 << ((hash >> bloomShift) % bits));
+    if((word & mask) != mask) return NULL;
+
+    uint32_t symbol = buckets[hash % nbuckets];
+    if(symbol < symoffset) return NULL;
+    for(;; symbol++) {
+        uint32_t chainHash = chain[symbol - symoffset];
+        if((hash | 1) == (chainHash | 1) && !strcmp(name, index->strtab + index->symtab[symbol].st_name))
+            return &index->symtab[symbol];
+        if(chainHash & 1) return NULL;
+    }
+}
+static const ElfW(Sym)* sysvHashLookup(const ElfSymbolIndex* index, const char* name) {
+    uint32_t hash = 0;
+    for(const char* c = name; *c; c++) {
+        hash = (hash << 4) + (uint8_t) *c;
+        uint32_t high = hash & 0xf0000000;
+        if(high) hash ^= high >> 24;
+        hash &= ~high;
+    }
+
+    uint32_t nbucket = index->sysvHash[0];
+    const uint32_t* buckets = &index->sysvHash[2];
+    const uint32_t* chains  = &buckets[nbucket];
+    for(uint32_t symbol = buckets[hash % nbucket]; symbol != STN_UNDEF; symbol = chains[symbol])
+        if(!strcmp(name, index->strtab + index->symtab[symbol].st_name)) return &index->symtab[symbol];
+    return NULL;
+}
+void* ElfSymbolIndex_lookup(const ElfSymbolIndex* index, const char* name) {
+    if(index->symtab == NULL || index->strtab == NULL) return NULL;
+
+    const ElfW(Sym)* symbol = NULL;
+    if     (index->gnuHash  != NULL) symbol = gnuHashLookup (index, name);
+    else if(index->sysvHash != NULL) symbol = sysvHashLookup(index, name);
+
+    if(symbol == NULL || symbol->st_shndx == SHN_UNDEF) return NULL;
+    return (void*) (index->base + symbol->st_value);
+}
@@ -0,0 +1,44 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <link.h>
+
+// Symbol lookup in the main executable's dynamic symbol table, using its DT_GNU_HASH or DT_HASH table, rather than
+// through dlsym, which searches every loaded object in turn.
+typedef struct ElfSymbolIndex {
+    ElfW(Addr) base;
+    size_t imageSize; // from base to the end of the highest loaded segment
+    const ElfW(Sym)* symtab;
+    const char* strtab;
+    const uint32_t* gnuHash;
+    const uint32_t* sysvHash;
+} ElfSymbolIndex;
+
+void ElfSymbolIndex_findExecutable(ElfSymbolIndex* index);
+
+// Returns the address of a symbol defined by the executable, or NULL if it is not defined there. DT_GNU_HASH is
+// preferred when both hash tables are present.
+void* ElfSymbolIndex_lookup(const ElfSymbolIndex* index, const char* name);
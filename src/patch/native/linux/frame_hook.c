@@ -0,0 +1,58 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <SDL.h>
+
+#include "c_rt.h"
+#include "config.h"
+#include "frame_stats.h"
+
+// Civ V presents every frame through SDL_GL_SwapWindow. Since the patch is loaded with LD_PRELOAD, defining it here
+// interposes on the game's calls, and the real function is found with RTLD_NEXT.
+static void (*realSwapWindow)(SDL_Window* window);
+static bool frameHookActive = false;
+
+static void findSwapWindow() {
+    realSwapWindow = dlsym(RTLD_NEXT, "SDL_GL_SwapWindow");
+}
+
+// The lookup is only done at startup when frame hitch detection is on. If it fails there, frames are not timed, but
+// the game is still started.
+__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void initFrameHook() {
+    if(!enableFrameHitchDetector) return;
+    findSwapWindow();
+    if(realSwapWindow != NULL) frameHookActive = true;
+    else debug_warn("Could not find SDL_GL_SwapWindow, frame hitch detection is disabled: %s", dlerror());
+}
+
+__attribute__((visibility("default"))) void SDL_GL_SwapWindow(SDL_Window* window) {
+    if(frameHookActive) FrameStats_endFrame();
+    else if(realSwapWindow == NULL) {
+        // SDL has to be loaded for the game to call this, so the lookup can only fail here if something is badly wrong.
+        findSwapWindow();
+        if(realSwapWindow == NULL) fatalError("Could not find SDL_GL_SwapWindow: %s", dlerror());
+    }
+    realSwapWindow(window);
+}
@@ -22,13 +22,21 @@
 
 #define _GNU_SOURCE
 
+#include <stdlib.h>
 #include <dlfcn.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <SDL.h>
 
 #include "c_rt.h"
 #include "platform.h"
+#include "symbols.h"
+#include "elf_index.h"
+#include "sync.h"
+#include "startup_profile.h"
 
 const char* getExecutablePath() {
     char* buffer = malloc(PATH_MAX + 1);
@@ -45,11 +53,68 @@ const char* getExecutablePath() {
 
 __attribute__((noreturn)) void fatalError_fn(const char* message) {
   fputs(message, stderr);
-  debug_print("%s", message);
+  debug_error("%s", message);
+  debugLog_flush();
   SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "MPPatch", message, 0);
   exit(1);
 }
 
+// Symbol resolution
+//
+// Required symbols are looked up directly in the main executable's dynamic symbol table, and anything not found there
+// falls back to dlsym.
+static ElfSymbolIndex executableIndex;
+static Mutex symbolLock = MUTEX_INITIALIZER;
+
+static void resolveRequiredSymbol(RequiredSymbol* symbol, void* data) {
+    int* found = (int*) data;
+    symbol->address = ElfSymbolIndex_lookup(&executableIndex, symbol->name);
+    symbol->inBinary = symbol->address != NULL;
+    if(symbol->inBinary) (*found)++;
+    else {
+        debug_warn("Required symbol %s not found in executable, falling back to dlsym.", symbol->name);
+        symbol->address = dlsym(RTLD_DEFAULT, symbol->name);
+    }
+    symbol->resolved = true;
+}
+__attribute__((constructor(CONSTRUCTOR_BINARY_INIT_EARLY))) static void loadSymbolsFromBinary() {
+    ElfSymbolIndex_findExecutable(&executableIndex);
+    if(executableIndex.gnuHash == NULL && executableIndex.sysvHash == NULL)
+        debug_warn("Executable has no symbol hash table, all symbols will be resolved with dlsym.");
+
+    Mutex_lock(&symbolLock);
+    if(!SymbolCache_load("/proc/self/exe", (void*) executableIndex.base, executableIndex.imageSize)) {
+        int found = 0;
+        RequiredSymbol_forEach(resolveRequiredSymbol, &found);
+        debug_print("Resolved %d of %d required symbols from the executable.", found, RequiredSymbol_count());
+        StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, RequiredSymbol_count());
+        SymbolCache_save("/proc/self/exe", (void*) executableIndex.base);
+    }
+    Mutex_unlock(&symbolLock);
+}
+
 void* resolveSymbol(const char* symbol) {
-    return dlsym(RTLD_DEFAULT, symbol);
-}
\ No newline at end of file
+    Mutex_lock(&symbolLock);
+    RequiredSymbol* entry = RequiredSymbol_find(symbol, RequiredSymbol_hash(symbol));
+    void* address;
+    if(entry != NULL && entry->resolved) address = entry->address;
+    else {
+        address = ElfSymbolIndex_lookup(&executableIndex, symbol);
+        if(address == NULL) address = dlsym(RTLD_DEFAULT, symbol);
+        StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, 1);
+    }
+    Mutex_unlock(&symbolLock);
+    return address;
+}
+
+uint64_t getMonotonicNanos() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+void waitOnAddress(volatile int* address, int expected) {
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+void wakeAddress(volatile int* address) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
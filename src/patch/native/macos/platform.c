@@ -23,17 +23,21 @@
 #include <stdio.h>
 
 #include <dlfcn.h>
+#include <sched.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <mach-o/dyld.h>
-#include <mach-o/nlist.h>
+#include <mach/mach_time.h>
 
 #include <CoreFoundation/CoreFoundation.h>
 
 #include "c_rt.h"
 #include "c_defines.h"
-#include "hashmap.h"
 #include "platform.h"
+#include "symbols.h"
+#include "symbol_image.h"
+#include "sync.h"
+#include "startup_profile.h"
 
 // Based on code used by Civ V for locating libCvGameCoreDLL_DLL.dylib, etc
 // If this breaks, then Civ V breaks
@@ -53,7 +57,8 @@ const char* getExecutablePath() {
 
 __attribute__((noreturn)) void fatalError_fn(const char* message) {
     fputs(message, stderr);
-    debug_print("%s", message);
+    debug_error("%s", message);
+    debugLog_flush();
 
     CFStringRef message_ref = CFStringCreateWithCString(NULL, message, strlen(message));
     CFOptionFlags result;
@@ -64,7 +69,7 @@ __attribute__((noreturn)) void fatalError_fn(const char* message) {
     exit(1);
 }
 
-static struct mach_header* getBinaryHeader() {
+static struct mach_header* getBinaryHeader(const char** path) {
     void* knownSymbol = dlsym(RTLD_DEFAULT, KNOWN_PUBLIC_BINARY_SYMBOL);
     if(!knownSymbol) fatalError("Could not find symbol %s.", KNOWN_PUBLIC_BINARY_SYMBOL);
 
@@ -72,53 +77,59 @@ static struct mach_header* getBinaryHeader() {
     if(!dladdr(knownSymbol, &info)) fatalError("Could not retrieve executable header.");
 
     debug_print("Target executable: %s", info.dli_fname);
+    *path = info.dli_fname;
     return (struct mach_header*) info.dli_fbase;
 }
 
-static void loadSymbols(map_t symbolMap, struct mach_header* image) {
-    struct segment_command* seg_text = NULL;
-    struct segment_command* seg_linkedit = NULL;
-	struct symtab_command* symtab = NULL;
-
-	void* current_cmd = (void*) image + sizeof(struct mach_header);
-	for(int i=0; i < image->ncmds; i++) {
-	    struct load_command* cmd = (struct load_command*) current_cmd;
-	    if(cmd->cmd == LC_SEGMENT) {
-            struct segment_command* segment = (struct segment_command*) current_cmd;
-                 if(!strcmp(segment->segname, SEG_TEXT    )) seg_text = segment;
-            else if(!strcmp(segment->segname, SEG_LINKEDIT)) seg_linkedit = segment;
-	    } else if(cmd->cmd == LC_SYMTAB) symtab = (struct symtab_command*) current_cmd;
-	    current_cmd += cmd->cmdsize;
-    }
-
-	if(seg_text == NULL || seg_linkedit == NULL || symtab == NULL) fatalError("Could not parse executable header.");
-
-    void* imageBase = (void*) image - seg_text->vmaddr;
-    void* linkeditFileBase = imageBase + seg_linkedit->vmaddr - seg_linkedit->fileoff;
-
-	struct nlist *symbase = (struct nlist*) (linkeditFileBase + symtab->symoff);
-	char *strings = (char*) (linkeditFileBase + symtab->stroff);
+static SymbolImage binaryImage;
+static Mutex symbolLock = MUTEX_INITIALIZER;
 
-    struct nlist* sym = symbase;
-	for(int i=0; i < symtab->nsyms; i++, sym++) if(sym->n_un.n_strx != 0) {
-        char* name = strings + sym->n_un.n_strx;
-        void* addr = imageBase + sym->n_value;
-
-        if(*name == '_') hashmap_put(symbolMap, name + 1, addr);
-        else             hashmap_put(symbolMap, name, addr);
-    }
+static void markResolved(RequiredSymbol* symbol, void* data) {
+    symbol->resolved = true;
+    symbol->inBinary = symbol->address != NULL;
 }
 
-static map_t symbolMap;
 __attribute__((constructor(CONSTRUCTOR_BINARY_INIT_EARLY))) static void loadSymbolsFromBinary() {
-    debug_print("Loading Civilization V binary symbols...");
-    symbolMap = hashmap_new();
-    loadSymbols(symbolMap, getBinaryHeader());
-    debug_print("Loaded %d symbols.", hashmap_length(symbolMap));
+    debug_print("Resolving Civilization V binary symbols...");
+    const char* binaryPath;
+    if(!SymbolImage_parse(&binaryImage, getBinaryHeader(&binaryPath)))
+        fatalError("Could not parse executable header.");
+
+    Mutex_lock(&symbolLock);
+    if(!SymbolCache_load(binaryPath, binaryImage.base, binaryImage.size)) {
+        int found = SymbolImage_resolveRequired(&binaryImage);
+        RequiredSymbol_forEach(markResolved, NULL);
+        debug_print("Resolved %d of %d required symbols. (%d symbols in binary)",
+                    found, RequiredSymbol_count(), binaryImage.count);
+        StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, RequiredSymbol_count());
+        SymbolCache_save(binaryPath, binaryImage.base);
+    }
+    Mutex_unlock(&symbolLock);
 }
 
 void* resolveSymbol(const char* symbol) {
-    any_t out;
-    if(hashmap_get(symbolMap, (char*) symbol, &out) == MAP_MISSING) return NULL;
-    return (void*) out;
-}
\ No newline at end of file
+    Mutex_lock(&symbolLock);
+    RequiredSymbol* entry = RequiredSymbol_find(symbol, RequiredSymbol_hash(symbol));
+    if(entry == NULL || !entry->resolved) {
+        debug_trace("Symbol %s was not resolved in advance, looking it up.", symbol);
+        if(entry == NULL) entry = RequiredSymbol_add(strdup(symbol));
+        entry->address  = SymbolImage_find(&binaryImage, symbol);
+        entry->resolved = true;
+        entry->inBinary = entry->address != NULL;
+        StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, 1);
+    }
+    void* address = entry->address;
+    Mutex_unlock(&symbolLock);
+    return address;
+}
+
+uint64_t getMonotonicNanos() {
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+void waitOnAddress(volatile int* address, int expected) {
+    if(*address == expected) sched_yield();
+}
+void wakeAddress(volatile int* address) {
+}
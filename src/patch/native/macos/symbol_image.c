@@ -0,0 +1,82 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <string.h>
+
+#include "symbol_image.h"
+#include "symbols.h"
+
+bool SymbolImage_parse(SymbolImage* out, struct mach_header* image) {
+    struct segment_command* seg_text = NULL;
+    struct segment_command* seg_linkedit = NULL;
+	struct symtab_command* symtab = NULL;
+    size_t imageSize = 0;
+
+	void* current_cmd = (void*) image + sizeof(struct mach_header);
+	for(int i=0; i < image->ncmds; i++) {
+	    struct load_command* cmd = (struct load_command*) current_cmd;
+	    if(cmd->cmd == LC_SEGMENT) {
+            struct segment_command* segment = (struct segment_command*) current_cmd;
+            if(segment->vmaddr + segment->vmsize > imageSize) imageSize = segment->vmaddr + segment->vmsize;
+                 if(!strcmp(segment->segname, SEG_TEXT    )) seg_text = segment;
+            else if(!strcmp(segment->segname, SEG_LINKEDIT)) seg_linkedit = segment;
+	    } else if(cmd->cmd == LC_SYMTAB) symtab = (struct symtab_command*) current_cmd;
+	    current_cmd += cmd->cmdsize;
+    }
+
+	if(seg_text == NULL || seg_linkedit == NULL || symtab == NULL) return false;
+
+    void* imageBase = (void*) image - seg_text->vmaddr;
+    void* linkeditFileBase = imageBase + seg_linkedit->vmaddr - seg_linkedit->fileoff;
+
+    out->symbols = (struct nlist*) (linkeditFileBase + symtab->symoff);
+    out->count   = symtab->nsyms;
+    out->strings = (char*) (linkeditFileBase + symtab->stroff);
+    out->base    = imageBase;
+    out->size    = imageSize;
+    return true;
+}
+static const char* symbolName(SymbolImage* image, struct nlist* sym) {
+    char* name = image->strings + sym->n_un.n_strx;
+    return *name == '_' ? name + 1 : name;
+}
+
+int SymbolImage_resolveRequired(SymbolImage* image) {
+    int found = 0;
+    struct nlist* sym = image->symbols;
+    for(uint32_t i=0; i < image->count; i++, sym++) if(sym->n_un.n_strx != 0) {
+        const char* name = symbolName(image, sym);
+        RequiredSymbol* entry = RequiredSymbol_find(name, RequiredSymbol_hash(name));
+        if(entry != NULL) {
+            if(entry->address == NULL) found++;
+            entry->address = image->base + sym->n_value;
+        }
+    }
+    return found;
+}
+void* SymbolImage_find(SymbolImage* image, const char* symbol) {
+    void* address = NULL;
+    struct nlist* sym = image->symbols;
+    for(uint32_t i=0; i < image->count; i++, sym++)
+        if(sym->n_un.n_strx != 0 && !strcmp(symbolName(image, sym), symbol)) address = image->base + sym->n_value;
+    return address;
+}
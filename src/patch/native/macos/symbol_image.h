@@ -0,0 +1,49 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+
+// The symbol table of a loaded Mach-O image.
+typedef struct SymbolImage {
+    struct nlist* symbols;
+    uint32_t count;
+    char* strings;
+    void* base;
+    size_t size; // from base to the end of the highest segment
+} SymbolImage;
+
+// Locates the symbol and string tables of a loaded image. Returns false if the load commands do not describe them.
+bool SymbolImage_parse(SymbolImage* out, struct mach_header* image);
+
+// Resolves every required symbol in one pass over the symbol table, and returns how many were found. When a name
+// appears more than once, the last entry wins.
+int SymbolImage_resolveRequired(SymbolImage* image);
+
+// Looks up a single symbol with a linear scan of the symbol table, or returns NULL if it is not present.
+void* SymbolImage_find(SymbolImage* image, const char* symbol);
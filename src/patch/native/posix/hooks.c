@@ -29,22 +29,32 @@
 #include "net_hook.h"
 #include "lua_hook.h"
 #include "config.h"
+#include "symbols.h"
 
 static PatchInformation* lGetMemoryUsage_patchInfo = NULL;
 PatchInformation* SetActiveDLCAndMods_patchInfo = NULL;
 
+__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void requireHookSymbols() {
+    requireSymbol(lGetMemoryUsage_symbol);
+    requireSymbol(SetActiveDLCAndMods_symbol);
+}
+
 __attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installHooks() {
     // Lua hook
     if(enableMultiplayerPatch) {
-        lGetMemoryUsage_patchInfo = proxyFunction(resolveSymbol(lGetMemoryUsage_symbol),
-                                                 lGetMemoryUsageProxy, lGetMemoryUsage_hook_length, "lGetMemoryUsage");
+        lGetMemoryUsage_patchInfo = PatchTransaction_proxyFunction(startupPatches,
+                                                                   resolveSymbol(lGetMemoryUsage_symbol),
+                                                                   lGetMemoryUsageProxy, lGetMemoryUsage_hook_length,
+                                                                   "lGetMemoryUsage");
         lGetMemoryUsage = (lGetMemoryUsage_t) lGetMemoryUsage_patchInfo->functionFragment->data;
     }
 }
 
-void installNetHook() {
-    SetActiveDLCAndMods_patchInfo = proxyFunction(resolveSymbol(SetActiveDLCAndMods_symbol),
-                                                  SetActiveDLCAndModsProxy, SetActiveDLCAndMods_hook_length,
-                                                  "SetActiveDLCAndMods");
+void installNetHook(PatchTransaction* transaction) {
+    SetActiveDLCAndMods_patchInfo = PatchTransaction_proxyFunction(transaction,
+                                                                   resolveSymbol(SetActiveDLCAndMods_symbol),
+                                                                   SetActiveDLCAndModsProxy,
+                                                                   SetActiveDLCAndMods_hook_length,
+                                                                   "SetActiveDLCAndMods");
     SetActiveDLCAndMods = (SetActiveDLCAndMods_t) SetActiveDLCAndMods_patchInfo->functionFragment->data;
 }
\ No newline at end of file
@@ -21,11 +21,15 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 
 #include "c_rt.h"
 #include "platform.h"
 #include "config.h"
+#include "symbols.h"
+#include "lua_profiler.h"
+#include "chunk_cache.h"
 
 static const char* luaJITSymbols[] = {
     "lua_pushfstring", "luaL_typerror", "luaL_register", "lua_getfield", "lua_pushvfstring", "luaL_pushresult",
@@ -52,6 +56,35 @@ static const char* luaJITSymbols[] = {
     "lua_atpanic"
 };
 
+__attribute__((constructor(CONSTRUCTOR_EARLY_INIT))) static void requireLuaJITSymbols() {
+    if(enableLuaJIT) requireSymbols(luaJITSymbols, sizeof(luaJITSymbols) / sizeof(const char*));
+}
+
+static void* luaJIT;
+void* resolveLuaJITSymbol(const char* symbol) {
+    return luaJIT == NULL ? NULL : dlsym(luaJIT, symbol);
+}
+
+// Lets other modules interpose on individual LuaJIT functions. Returns the function the Civ V symbol should jump to,
+// after saving the LuaJIT implementation for the replacement to call through to.
+static void* filterLuaJITSymbol(const char* symbol, void* patchSym) {
+    if(enableLuaProfiler) {
+        if(!strcmp(symbol, "lua_pcall")) {
+            LuaProfiler_originalPcall = (lua_pcall_t) patchSym;
+            return LuaProfiler_pcall;
+        }
+        if(!strcmp(symbol, "lua_call")) {
+            LuaProfiler_originalCall = (lua_call_t) patchSym;
+            return LuaProfiler_call;
+        }
+    }
+    if(enableChunkCache && !strcmp(symbol, "luaL_loadbuffer")) {
+        ChunkCache_originalLoadBuffer = (luaL_loadbuffer_t) patchSym;
+        return ChunkCache_loadBuffer;
+    }
+    return patchSym;
+}
+
 __attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installLuaJIT() {
     if(enableLuaJIT) {
         debug_print("Loading LuaJIT...");
@@ -59,7 +92,7 @@ __attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installLuaJIT()
         char buffer[PATH_MAX];
         getSupportFilePath(buffer, LUAJIT_LIBRARY);
 
-        void* luaJIT = dlopen(buffer, RTLD_LOCAL | RTLD_NOW);
+        luaJIT = dlopen(buffer, RTLD_LOCAL | RTLD_NOW);
         if(luaJIT == NULL) fatalError("Could not open LuaJIT library: %s", dlerror());
 
         for(int i=0; i < sizeof(luaJITSymbols) / sizeof(const char*); i++) {
@@ -68,11 +101,16 @@ __attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installLuaJIT()
             void* targetSym = resolveSymbol(symbol);
             void* patchSym  = dlsym(luaJIT, symbol);
 
-            if(targetSym == NULL) debug_print("WARNING: Symbol %s does not exist in Civ V binary.", symbol);
-            if(patchSym  == NULL) debug_print("WARNING: Symbol %s does not exist in LuaJIT binary.", symbol);
+            if(targetSym == NULL) debug_warn("Symbol %s does not exist in Civ V binary.", symbol);
+            if(patchSym  == NULL) debug_warn("Symbol %s does not exist in LuaJIT binary.", symbol);
             if(targetSym == NULL || patchSym == NULL) continue;
 
-            patchJmpInstruction(targetSym, patchSym, symbol);
+            PatchTransaction_patchJmp(startupPatches, targetSym, filterLuaJITSymbol(symbol, patchSym), symbol);
         }
+
+        if(enableLuaProfiler) debug_print("Lua callback profiling enabled.");
+    } else {
+        if(enableLuaProfiler) debug_warn("enableLuaProfiler requires enableLuaJIT, Lua callbacks will not be profiled.");
+        if(enableChunkCache ) debug_warn("enableChunkCache requires enableLuaJIT, Lua chunks will not be cached.");
     }
 }
\ No newline at end of file
@@ -22,21 +22,27 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "c_rt.h"
 #include "c_defines.h"
 #include "platform.h"
+#include "sync.h"
+#include "startup_profile.h"
 
-void setupProxyFunction(void* entry, const char* symbol) {
+void setupProxyFunction(PatchTransaction* transaction, void* entry, const char* symbol) {
     void* ptr = resolveSymbol(symbol);
-    if(!symbol) fatalError("Linking proxy defines symbol %s, which doesn't exist.", symbol);
+    if(!ptr) fatalError("Linking proxy defines symbol %s, which doesn't exist.", symbol);
 
     char buffer[1024];
     snprintf(buffer, sizeof(buffer), "proxy for %s", symbol);
-    patchJmpInstruction(entry, ptr, buffer);
+    PatchTransaction_patchJmp(transaction, entry, ptr, buffer);
 }
 
 // Memory management functions
@@ -44,7 +50,8 @@ static int protectRange(size_t start, size_t length, int flags) {
     int page_size = getpagesize();
     size_t end = start + length;
     start = (start / page_size) * page_size;
-    end   = ((end + page_size) / page_size) * page_size;
+    end   = ((end + page_size - 1) / page_size) * page_size;
+    StartupProfile_count(STARTUP_COUNTER_PROTECT_CALLS, 1);
     return mprotect((void*) start, end - start, flags);
 }
 void unprotectMemoryRegion(void* start, size_t length, memory_oldProtect* old) {
@@ -54,17 +61,151 @@ void protectMemoryRegion  (void* start, size_t length, memory_oldProtect* old) {
   protectRange((size_t) start, length, PROT_READ | PROT_EXEC);
 }
 
+// Executable memory is handed out in fixed-size slots packed into shared arena pages, since function fragments are only
+// a few bytes long. An arena page is writable only while one of its slots is between executable_malloc and
+// executable_prepare, and is otherwise read/execute only. Patch transactions prepare all of their fragments on commit,
+// so the fragments created by one transaction share a page.
+//
+// New fragments are only placed on pages that hold no prepared fragments, so a page never loses exec permission while
+// code on it may be running. A page whose fragments have all been freed is reused, and arena pages are never unmapped,
+// so arming and disarming hooks repeatedly does not map or unmap any memory.
+#define EXECUTABLE_SLOT_SIZE 64
+
+typedef struct ExecutablePage {
+    struct ExecutablePage* next;
+    char* base;
+    uint64_t usedSlots;     // one bit per slot
+    uint64_t preparedSlots; // slots that have been prepared and not yet freed
+    int writers;
+} ExecutablePage;
+
+static ExecutablePage* executablePages = NULL;
+static Mutex executableLock = MUTEX_INITIALIZER;
+
+static int executableSlotCount() {
+    int slots = getpagesize() / EXECUTABLE_SLOT_SIZE;
+    return slots > 64 ? 64 : slots;
+}
+static ExecutablePage* findExecutablePage(void* ptr) {
+    char* base = (char*) ((size_t) ptr & ~(size_t) (getpagesize() - 1));
+    for(ExecutablePage* page = executablePages; page != NULL; page = page->next)
+        if(page->base == base) return page;
+    return NULL;
+}
+static ExecutablePage* newExecutablePage() {
+    ExecutablePage* page = malloc(sizeof(ExecutablePage));
+    page->base = mmap(NULL, getpagesize(), PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(page->base == MAP_FAILED) fatalError("Could not map executable memory.");
+    StartupProfile_count(STARTUP_COUNTER_BYTES_MAPPED, getpagesize());
+    page->usedSlots     = 0;
+    page->preparedSlots = 0;
+    page->writers       = 0;
+    page->next          = executablePages;
+    executablePages = page;
+    debug_trace("Mapped executable arena page at %p", page->base);
+    return page;
+}
+
 ExecutableMemory* executable_malloc(int length) {
-    ExecutableMemory* memory = (ExecutableMemory*) mmap(NULL, sizeof(ExecutableMemory) + length,
-                                                        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(sizeof(ExecutableMemory) + length > EXECUTABLE_SLOT_SIZE) {
+        // Too large for the arena. Nothing we patch needs this, but keep it working.
+        ExecutableMemory* memory = (ExecutableMemory*) mmap(NULL, sizeof(ExecutableMemory) + length,
+                                                            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) fatalError("Could not map executable memory.");
+        StartupProfile_count(STARTUP_COUNTER_BYTES_MAPPED, sizeof(ExecutableMemory) + length);
+        memory->length = length;
+        return memory;
+    }
+
+    Mutex_lock(&executableLock);
+    uint64_t fullPage = executableSlotCount() == 64 ? ~0ULL : (1ULL << executableSlotCount()) - 1;
+    ExecutablePage* page = executablePages;
+    while(page != NULL && (page->preparedSlots != 0 || page->usedSlots == fullPage)) page = page->next;
+    if(page == NULL) page = newExecutablePage();
+
+    int slot = __builtin_ctzll(~page->usedSlots);
+    page->usedSlots |= 1ULL << slot;
+    if(page->writers++ == 0) protectRange((size_t) page->base, getpagesize(), PROT_READ | PROT_WRITE);
+    Mutex_unlock(&executableLock);
+
+    ExecutableMemory* memory = (ExecutableMemory*) (page->base + slot * EXECUTABLE_SLOT_SIZE);
     memory->length = length;
     return memory;
 }
+static void executablePage_endWrite(ExecutablePage* page) {
+    if(--page->writers == 0) protectRange((size_t) page->base, getpagesize(), PROT_READ | PROT_EXEC);
+}
 void executable_prepare(ExecutableMemory* memory) {
-    protectMemoryRegion(memory, memory->length, NULL);
+    Mutex_lock(&executableLock);
+    ExecutablePage* page = findExecutablePage(memory);
+    if(page == NULL) protectMemoryRegion(memory, sizeof(ExecutableMemory) + memory->length, NULL);
+    else {
+        page->preparedSlots |= 1ULL << (((char*) memory - page->base) / EXECUTABLE_SLOT_SIZE);
+        executablePage_endWrite(page);
+    }
+    Mutex_unlock(&executableLock);
 }
 void executable_free(ExecutableMemory* memory) {
-    munmap(memory, memory->length);
+    Mutex_lock(&executableLock);
+    ExecutablePage* page = findExecutablePage(memory);
+    if(page == NULL) munmap(memory, sizeof(ExecutableMemory) + memory->length);
+    else {
+        uint64_t slotBit = 1ULL << (((char*) memory - page->base) / EXECUTABLE_SLOT_SIZE);
+        if(!(page->preparedSlots & slotBit)) executablePage_endWrite(page); // freed before it was ever prepared
+        page->usedSlots     &= ~slotBit;
+        page->preparedSlots &= ~slotBit;
+    }
+    Mutex_unlock(&executableLock);
+}
+
+// Threading functions
+typedef struct ThreadStart {
+    void (*fn)(void*);
+    void* arg;
+} ThreadStart;
+static void* threadEntry(void* data) {
+    ThreadStart start = *(ThreadStart*) data;
+    free(data);
+    start.fn(start.arg);
+    return NULL;
+}
+void startThread(void (*fn)(void*), void* arg) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    start->fn  = fn;
+    start->arg = arg;
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, threadEntry, start)) fatalError("Could not start background thread.");
+    pthread_detach(thread);
+}
+void sleepMilliseconds(int ms) {
+    struct timespec time = { ms / 1000, (ms % 1000) * 1000000 };
+    nanosleep(&time, NULL);
+}
+
+// Process functions
+uint32_t getProcessId() {
+    return getpid();
+}
+void* allocateAlignedMemory(size_t size) {
+    // Over-allocate, then trim the unaligned head and tail.
+    char* memory = mmap(NULL, size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED) return NULL;
+    char* aligned = (char*) (((uintptr_t) memory + size - 1) & ~(uintptr_t) (size - 1));
+    if(aligned != memory) munmap(memory, aligned - memory);
+    munmap(aligned + size, memory + size - aligned);
+    return aligned;
+}
+void* mapSharedFile(const char* path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd == -1) return NULL;
+    if(ftruncate(fd, size) == -1) {
+        close(fd);
+        return NULL;
+    }
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return memory == MAP_FAILED ? NULL : memory;
 }
 
 // std::list implementation
@@ -31,4 +31,7 @@
 #define SetActiveDLCAndMods_attributes __attribute__((cdecl))
 
 void* resolveSymbol(const char* symbol);
-void setupProxyFunction(void* entry, const char* symbol);
\ No newline at end of file
+// Looks up a function in the bundled LuaJIT library, or returns NULL if LuaJIT is not loaded.
+void* resolveLuaJITSymbol(const char* symbol);
+struct PatchTransaction;
+void setupProxyFunction(struct PatchTransaction* transaction, void* entry, const char* symbol);
\ No newline at end of file
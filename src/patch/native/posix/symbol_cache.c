@@ -0,0 +1,217 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "c_rt.h"
+#include "symbols.h"
+#include "startup_profile.h"
+
+// The cache is a header, then one entry per symbol, then the symbol names. Offsets are relative to the binary's load
+// address. Besides the build id and the binary's size and mtime, every entry records the first bytes of its target,
+// which are checked against memory on load. That catches a binary replaced in place with the same size and mtime.
+#define SYMBOL_CACHE_FILENAME "mppatch_symbols.cache"
+#define SYMBOL_CACHE_MAGIC    "MPPSYMC1"
+#define SYMBOL_CACHE_SPOT_BYTES 8
+#define SYMBOL_CACHE_NOT_IN_BINARY 0xFFFFFFFFU
+
+typedef struct SymbolCacheHeader {
+    char magic[8];
+    char civVersion[80];
+    char buildId[80];
+    uint64_t binarySize;
+    int64_t binaryMtime;
+    uint32_t count;
+    uint32_t stringBytes;
+} SymbolCacheHeader;
+typedef struct SymbolCacheEntry {
+    uint32_t nameOffset;
+    uint32_t offset;
+    uint8_t spot[SYMBOL_CACHE_SPOT_BYTES];
+} SymbolCacheEntry;
+
+static bool getBinaryIdentity(const char* binaryPath, SymbolCacheHeader* header) {
+    struct stat binaryStat;
+    if(stat(binaryPath, &binaryStat)) return false;
+
+    memset(header, 0, sizeof(SymbolCacheHeader));
+    memcpy(header->magic, SYMBOL_CACHE_MAGIC, 8);
+    strncpy(header->civVersion, MPPATCH_CIV_VERSION, sizeof(header->civVersion) - 1);
+    strncpy(header->buildId   , MPPATCH_BUILDID    , sizeof(header->buildId   ) - 1);
+    header->binarySize  = binaryStat.st_size;
+    header->binaryMtime = binaryStat.st_mtime;
+    return true;
+}
+
+bool SymbolCache_load(const char* binaryPath, void* binaryBase, size_t imageSize) {
+    SymbolCacheHeader identity;
+    if(!getBinaryIdentity(binaryPath, &identity)) return false;
+
+    char buffer[PATH_MAX];
+    getSupportFilePath(buffer, SYMBOL_CACHE_FILENAME);
+    int fd = open(buffer, O_RDONLY);
+    if(fd == -1) return false;
+
+    struct stat cacheStat;
+    if(fstat(fd, &cacheStat) || cacheStat.st_size < sizeof(SymbolCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    void* cache = mmap(NULL, cacheStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(cache == MAP_FAILED) return false;
+
+    bool valid = false;
+    const SymbolCacheHeader* header = (const SymbolCacheHeader*) cache;
+    const SymbolCacheEntry* entries = (const SymbolCacheEntry*) (header + 1);
+    const char* strings;
+
+    if(memcmp(header, &identity, offsetof(SymbolCacheHeader, count))) {
+        debug_print("Symbol cache is for a different binary or build, ignoring it.");
+        goto end;
+    }
+    // The size check is done by subtraction, so that a corrupt count cannot overflow it on 32-bit builds.
+    size_t entryBytes = (size_t) cacheStat.st_size - sizeof(SymbolCacheHeader);
+    if(header->count > entryBytes / sizeof(SymbolCacheEntry) || header->stringBytes == 0 ||
+       entryBytes - header->count * sizeof(SymbolCacheEntry) != header->stringBytes) {
+        debug_warn("Symbol cache is corrupt, ignoring it.");
+        goto end;
+    }
+    strings = (const char*) (entries + header->count);
+    if(strings[header->stringBytes - 1] != '\0') {
+        debug_warn("Symbol cache is corrupt, ignoring it.");
+        goto end;
+    }
+
+    // Check every entry before touching the registry, so a stale cache leaves no partial results behind.
+    int matched = 0;
+    for(uint32_t i=0; i<header->count; i++) {
+        const SymbolCacheEntry* entry = &entries[i];
+        if(entry->nameOffset >= header->stringBytes) goto end;
+        if(entry->offset != SYMBOL_CACHE_NOT_IN_BINARY &&
+           (entry->offset > imageSize || imageSize - entry->offset < SYMBOL_CACHE_SPOT_BYTES)) {
+            debug_warn("Symbol cache is corrupt, ignoring it.");
+            goto end;
+        }
+
+        const char* name = strings + entry->nameOffset;
+        if(RequiredSymbol_find(name, RequiredSymbol_hash(name)) != NULL) matched++;
+        if(entry->offset != SYMBOL_CACHE_NOT_IN_BINARY &&
+           memcmp(binaryBase + entry->offset, entry->spot, SYMBOL_CACHE_SPOT_BYTES)) {
+            debug_print("Symbol cache does not match the code at %s, ignoring it.", name);
+            goto end;
+        }
+    }
+    if(matched != RequiredSymbol_count()) {
+        debug_print("Symbol cache does not cover every required symbol, ignoring it.");
+        goto end;
+    }
+
+    for(uint32_t i=0; i<header->count; i++) {
+        const SymbolCacheEntry* entry = &entries[i];
+        const char* name = strings + entry->nameOffset;
+        RequiredSymbol* symbol = RequiredSymbol_find(name, RequiredSymbol_hash(name));
+        if(symbol == NULL) continue;
+
+        // Symbols that came from outside the binary are left for resolveSymbol to look up again.
+        symbol->inBinary = entry->offset != SYMBOL_CACHE_NOT_IN_BINARY;
+        symbol->resolved = symbol->inBinary;
+        symbol->address  = symbol->inBinary ? binaryBase + entry->offset : NULL;
+    }
+    debug_print("Loaded %d symbols from the symbol cache.", matched);
+    StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, matched);
+    valid = true;
+
+end:
+    munmap(cache, cacheStat.st_size);
+    return valid;
+}
+
+typedef struct SymbolCacheWriter {
+    SymbolCacheEntry* entries;
+    char* strings;
+    uint32_t count, stringBytes;
+    void* binaryBase;
+} SymbolCacheWriter;
+static void measureSymbol(RequiredSymbol* symbol, void* data) {
+    ((SymbolCacheWriter*) data)->stringBytes += strlen(symbol->name) + 1;
+}
+static void writeSymbol(RequiredSymbol* symbol, void* data) {
+    SymbolCacheWriter* writer = (SymbolCacheWriter*) data;
+    SymbolCacheEntry* entry = &writer->entries[writer->count++];
+
+    size_t length = strlen(symbol->name) + 1;
+    memcpy(writer->strings + writer->stringBytes, symbol->name, length);
+    entry->nameOffset = writer->stringBytes;
+    writer->stringBytes += length;
+
+    if(symbol->resolved && symbol->inBinary) {
+        entry->offset = symbol->address - writer->binaryBase;
+        memcpy(entry->spot, symbol->address, SYMBOL_CACHE_SPOT_BYTES);
+    } else {
+        entry->offset = SYMBOL_CACHE_NOT_IN_BINARY;
+        memset(entry->spot, 0, SYMBOL_CACHE_SPOT_BYTES);
+    }
+}
+void SymbolCache_save(const char* binaryPath, void* binaryBase) {
+    SymbolCacheHeader header;
+    if(!getBinaryIdentity(binaryPath, &header) || RequiredSymbol_count() == 0) return;
+
+    SymbolCacheWriter writer = { NULL, NULL, 0, 0, binaryBase };
+    RequiredSymbol_forEach(measureSymbol, &writer);
+    header.count       = RequiredSymbol_count();
+    header.stringBytes = writer.stringBytes;
+    writer.entries     = malloc(header.count * sizeof(SymbolCacheEntry) + header.stringBytes);
+    writer.strings     = (char*) (writer.entries + header.count);
+    writer.stringBytes = 0;
+    RequiredSymbol_forEach(writeSymbol, &writer);
+
+    // Write to a temporary file first, so that a concurrent launch never sees a partial cache.
+    char buffer[PATH_MAX], tempBuffer[PATH_MAX + 16];
+    getSupportFilePath(buffer, SYMBOL_CACHE_FILENAME);
+    snprintf(tempBuffer, sizeof(tempBuffer), "%s.%d", buffer, (int) getpid());
+
+    FILE* file = fopen(tempBuffer, "wb");
+    if(file == NULL) {
+        debug_warn("Could not write symbol cache.");
+        free(writer.entries);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(SymbolCacheHeader), 1, file) == 1 &&
+              fwrite(writer.entries, header.count * sizeof(SymbolCacheEntry) + header.stringBytes, 1, file) == 1;
+    ok = !fclose(file) && ok;
+    if(ok) ok = !rename(tempBuffer, buffer);
+    if(!ok) {
+        debug_warn("Could not write symbol cache.");
+        unlink(tempBuffer);
+    } else debug_print("Wrote %d symbols to the symbol cache.", header.count);
+
+    free(writer.entries);
+}
@@ -0,0 +1,93 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_rt.h"
+#include "symbols.h"
+
+// Open addressing with linear probing. The table is kept at most half full, so probes stay short, and the names are
+// only compared once the hashes match.
+static RequiredSymbol* symbolTable = NULL;
+static uint32_t symbolTableCapacity = 0, symbolTableCount = 0;
+
+uint32_t RequiredSymbol_hash(const char* name) {
+    uint32_t hash = 2166136261U; // FNV-1a
+    for(const char* c = name; *c; c++) hash = (hash ^ (uint8_t) *c) * 16777619U;
+    return hash;
+}
+
+static RequiredSymbol* findSlot(RequiredSymbol* table, uint32_t capacity, const char* name, uint32_t hash) {
+    for(uint32_t i = hash & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        RequiredSymbol* entry = &table[i];
+        if(entry->name == NULL || (entry->hash == hash && !strcmp(entry->name, name))) return entry;
+    }
+}
+static void growTable() {
+    uint32_t newCapacity = symbolTableCapacity == 0 ? 256 : symbolTableCapacity * 2;
+    RequiredSymbol* newTable = calloc(newCapacity, sizeof(RequiredSymbol));
+    if(newTable == NULL) fatalError("Could not allocate symbol table.");
+
+    for(uint32_t i=0; i<symbolTableCapacity; i++) if(symbolTable[i].name != NULL) {
+        RequiredSymbol* entry = &symbolTable[i];
+        *findSlot(newTable, newCapacity, entry->name, entry->hash) = *entry;
+    }
+
+    free(symbolTable);
+    symbolTable = newTable;
+    symbolTableCapacity = newCapacity;
+}
+
+RequiredSymbol* RequiredSymbol_find(const char* name, uint32_t hash) {
+    if(symbolTableCount == 0) return NULL;
+    RequiredSymbol* entry = findSlot(symbolTable, symbolTableCapacity, name, hash);
+    return entry->name == NULL ? NULL : entry;
+}
+RequiredSymbol* RequiredSymbol_add(const char* name) {
+    if((symbolTableCount + 1) * 2 > symbolTableCapacity) growTable();
+
+    uint32_t hash = RequiredSymbol_hash(name);
+    RequiredSymbol* entry = findSlot(symbolTable, symbolTableCapacity, name, hash);
+    if(entry->name == NULL) {
+        entry->name     = name;
+        entry->hash     = hash;
+        entry->resolved = false;
+        entry->inBinary = false;
+        entry->address  = NULL;
+        symbolTableCount++;
+    }
+    return entry;
+}
+int RequiredSymbol_count() {
+    return symbolTableCount;
+}
+void RequiredSymbol_forEach(void (*fn)(RequiredSymbol* symbol, void* data), void* data) {
+    for(uint32_t i=0; i<symbolTableCapacity; i++) if(symbolTable[i].name != NULL) fn(&symbolTable[i], data);
+}
+
+void requireSymbol(const char* symbol) {
+    RequiredSymbol_add(symbol);
+}
+void requireSymbols(const char* const* symbols, int count) {
+    for(int i=0; i<count; i++) RequiredSymbol_add(symbols[i]);
+}
@@ -0,0 +1,52 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Symbols the patch needs from the game binary. Modules register them before CONSTRUCTOR_BINARY_INIT_EARLY, so that
+// the platform can resolve all of them in a single pass over the binary's symbol table. Symbols that were not
+// registered are looked up on demand when resolveSymbol is first called for them.
+void requireSymbol(const char* symbol);
+void requireSymbols(const char* const* symbols, int count);
+
+typedef struct RequiredSymbol {
+    const char* name;
+    uint32_t hash;
+    bool resolved;
+    bool inBinary; // address points into the game binary, rather than coming from a dlsym fallback
+    void* address;
+} RequiredSymbol;
+
+uint32_t RequiredSymbol_hash(const char* name);
+RequiredSymbol* RequiredSymbol_find(const char* name, uint32_t hash);
+RequiredSymbol* RequiredSymbol_add(const char* name);
+int RequiredSymbol_count();
+void RequiredSymbol_forEach(void (*fn)(RequiredSymbol* symbol, void* data), void* data);
+
+// Caches the resolved offsets of required symbols on disk, so later launches of the same binary can skip resolution.
+// SymbolCache_load returns true only if every registered symbol was restored from the cache. imageSize is the number of
+// bytes mapped from binaryBase onwards, and bounds the offsets a cache may contain.
+bool SymbolCache_load(const char* binaryPath, void* binaryBase, size_t imageSize);
+void SymbolCache_save(const char* binaryPath, void* binaryBase);
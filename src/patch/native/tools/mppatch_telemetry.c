@@ -0,0 +1,122 @@
+/**
+    Copyright (C) 2015-2017 Lymia Aluysia <lymiahugs@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished to do
+    so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Samples the telemetry page published by the native patch when enableTelemetry is set. This only maps the file
+// read-only, and never touches the game process itself.
+//
+// Build: sbt native-patch-telemetry-tool, or cc -O2 -I../common -o mppatch_telemetry mppatch_telemetry.c
+// Usage: mppatch_telemetry <path to mppatch_telemetry.bin> [interval ms] [samples]
+//
+// With no interval, prints one sample. With an interval and no sample count, samples until interrupted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "telemetry.h"
+
+static const char* counterNames[TELEMETRY_COUNTER_COUNT] = {
+    [TELEMETRY_LGETMEMORYUSAGE_CALLS             ] = "lGetMemoryUsageCalls",
+    [TELEMETRY_SETACTIVEDLCANDMODS_CALLS         ] = "setActiveDLCAndModsCalls",
+    [TELEMETRY_SETACTIVEDLCANDMODS_ORIGINAL_CALLS] = "setActiveDLCAndModsOriginalCalls",
+    [TELEMETRY_OVERRIDES_APPLIED                 ] = "overridesApplied",
+    [TELEMETRY_RELOADS                           ] = "reloads",
+    [TELEMETRY_RELOADS_SKIPPED                   ] = "reloadsSkipped",
+    [TELEMETRY_RELOAD_NANOS                      ] = "reloadNanos",
+    [TELEMETRY_LAST_RELOAD_NANOS                 ] = "lastReloadNanos",
+    [TELEMETRY_LUA_MEMORY_KB                     ] = "luaMemoryKB",
+    [TELEMETRY_LOG_DROPS                         ] = "logDrops",
+};
+
+// Copies the page between two reads of an even sequence number. A copy made while the patch was writing is torn, so it
+// is retried.
+static bool readPage(const TelemetryPage* page, TelemetryPage* out) {
+    for(int attempt=0; attempt<1000; attempt++) {
+        if(attempt != 0) sched_yield();
+        uint32_t before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if(before & 1) continue;
+        memcpy(out, (const void*) page, sizeof(TelemetryPage));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == before) return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s <telemetry file> [interval ms] [samples]\n", argv[0]);
+        return 1;
+    }
+    int interval = argc > 2 ? atoi(argv[2]) : 0;
+    int samples  = argc > 3 ? atoi(argv[3]) : (interval > 0 ? -1 : 1);
+
+    int fd = open(argv[1], O_RDONLY);
+    if(fd == -1) {
+        perror("Could not open telemetry file");
+        return 1;
+    }
+    const TelemetryPage* page = mmap(NULL, sizeof(TelemetryPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(page == MAP_FAILED) {
+        perror("Could not map telemetry file");
+        return 1;
+    }
+
+    TelemetryPage sample;
+    if(!readPage(page, &sample) || memcmp(sample.magic, TELEMETRY_MAGIC, sizeof(sample.magic))) {
+        fprintf(stderr, "Not a telemetry file, or it is still being initialized.\n");
+        return 1;
+    }
+    if(sample.version != TELEMETRY_VERSION || sample.size != sizeof(TelemetryPage)) {
+        fprintf(stderr, "Unsupported telemetry version %u (expected %u).\n", sample.version, TELEMETRY_VERSION);
+        return 1;
+    }
+    printf("# pid %u, build %.40s\n", sample.pid, sample.buildId);
+    if(kill(sample.pid, 0) == -1) printf("# process %u is no longer running\n", sample.pid);
+
+    printf("sequence");
+    for(int i=0; i<TELEMETRY_COUNTER_COUNT; i++) printf("\t%s", counterNames[i]);
+    printf("\n");
+
+    for(int i=0; samples < 0 || i < samples; i++) {
+        if(i != 0) {
+            struct timespec time = { interval / 1000, (interval % 1000) * 1000000 };
+            nanosleep(&time, NULL);
+        }
+        if(!readPage(page, &sample)) {
+            fprintf(stderr, "Could not get a consistent sample.\n");
+            continue;
+        }
+        printf("%u", sample.sequence);
+        for(int j=0; j<TELEMETRY_COUNTER_COUNT; j++) printf("\t%llu", (unsigned long long) sample.counters[j]);
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
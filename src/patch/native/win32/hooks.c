@@ -78,10 +78,11 @@ __attribute__((constructor(CONSTRUCTOR_HOOK_INIT))) static void installHooks() {
     lGetMemoryUsage = resolveSymbol(lGetMemoryUsage_symbol);
 }
 
-void installNetHook() {
+void installNetHook(PatchTransaction* transaction) {
     void* offset    = resolveAddress(switchOnType(detectedBinaryType, SetActiveDLCAndMods_offset));
     int   patchSize = switchOnType(detectedBinaryType, SetActiveDLCAndMods_hook_length);
 
-    SetActiveDLCAndMods_patchInfo = proxyFunction(offset, SetActiveDLCAndModsProxy, patchSize, "SetActiveDLCAndMods");
+    SetActiveDLCAndMods_patchInfo = PatchTransaction_proxyFunction(transaction, offset, SetActiveDLCAndModsProxy,
+                                                                   patchSize, "SetActiveDLCAndMods");
     SetActiveDLCAndMods = (SetActiveDLCAndMods_t) SetActiveDLCAndMods_patchInfo->functionFragment->data;
 }
\ No newline at end of file
@@ -28,6 +28,7 @@
 #include "c_rt.h"
 #include "c_defines.h"
 #include "platform.h"
+#include "startup_profile.h"
 
 // Memory management functions
 const char* getExecutablePath() {
@@ -41,21 +42,25 @@ const char* getExecutablePath() {
 }
 
 __attribute__((noreturn)) void fatalError_fn(const char* message) {
-    debug_print("%s", message);
+    debug_error("%s", message);
+    debugLog_flush();
     FatalAppExit(0, message);
     exit(1);
 }
 
 void unprotectMemoryRegion(void* start, size_t length, memory_oldProtect* old) {
     VirtualProtect(start, length, PAGE_EXECUTE_READWRITE, old);
+    StartupProfile_count(STARTUP_COUNTER_PROTECT_CALLS, 1);
 }
 void protectMemoryRegion  (void* start, size_t length, memory_oldProtect* old) {
     VirtualProtect(start, length, *old, old);
+    StartupProfile_count(STARTUP_COUNTER_PROTECT_CALLS, 1);
 }
 
 ExecutableMemory* executable_malloc(int length) {
     ExecutableMemory* memory = (ExecutableMemory*) VirtualAlloc(NULL, sizeof(ExecutableMemory) + length,
                                                                 MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    StartupProfile_count(STARTUP_COUNTER_BYTES_MAPPED, sizeof(ExecutableMemory) + length);
     memory->length = length;
     return memory;
 }
@@ -64,6 +69,72 @@ void executable_free(ExecutableMemory* memory) {
     VirtualFree(memory, memory->length, MEM_RELEASE);
 }
 
+// Threading functions
+typedef struct ThreadStart {
+    void (*fn)(void*);
+    void* arg;
+} ThreadStart;
+static DWORD WINAPI threadEntry(LPVOID data) {
+    ThreadStart start = *(ThreadStart*) data;
+    free(data);
+    start.fn(start.arg);
+    return 0;
+}
+void startThread(void (*fn)(void*), void* arg) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    start->fn  = fn;
+    start->arg = arg;
+
+    HANDLE thread = CreateThread(NULL, 0, threadEntry, start, 0, NULL);
+    if(thread == NULL) fatalError("Could not start background thread. (code: 0x%08lx)", GetLastError());
+    CloseHandle(thread);
+}
+void sleepMilliseconds(int ms) {
+    Sleep(ms);
+}
+uint64_t getMonotonicNanos() {
+    static LARGE_INTEGER frequency;
+    if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+}
+void waitOnAddress(volatile int* address, int expected) {
+    if(*address == expected) SwitchToThread();
+}
+void wakeAddress(volatile int* address) {
+}
+
+// Process functions
+uint32_t getProcessId() {
+    return GetCurrentProcessId();
+}
+void* allocateAlignedMemory(size_t size) {
+    // VirtualAlloc only aligns to 64KB, so find an aligned address in a larger reservation, release it, and claim the
+    // aligned part. Another thread may take the address in between, in which case this is retried.
+    for(int attempt=0; attempt<16; attempt++) {
+        char* memory = VirtualAlloc(NULL, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if(memory == NULL) return NULL;
+        char* aligned = (char*) (((uintptr_t) memory + size - 1) & ~(uintptr_t) (size - 1));
+        VirtualFree(memory, 0, MEM_RELEASE);
+        memory = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if(memory != NULL) return memory;
+    }
+    return NULL;
+}
+void* mapSharedFile(const char* path, size_t size) {
+    HANDLE file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return NULL;
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READWRITE, 0, size, NULL);
+    CloseHandle(file);
+    if(mapping == NULL) return NULL;
+    void* memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(mapping);
+    return memory;
+}
+
 // Symbol resolution
 static HMODULE baseDll;
 #define TARGET_LIBRARY_NAME "CvGameDatabase_Original.dll"
@@ -81,11 +152,16 @@ __attribute__((constructor(CONSTRUCTOR_BINARY_INIT_EARLY))) static void initiali
 void* resolveSymbol(const char* symbol) {
     void* procAddress = GetProcAddress(baseDll, symbol);
     if(!procAddress) fatalError("Failed to load symbol %s.", symbol);
+    StartupProfile_count(STARTUP_COUNTER_SYMBOLS_RESOLVED, 1);
 
     debug_print("Resolving symbol - %s = %p", symbol, procAddress);
 
     return procAddress;
 }
+void* resolveLuaJITSymbol(const char* symbol) {
+    // LuaJIT is only supported on Linux and macOS.
+    return NULL;
+}
 
 // std::list implementation
 CppList* CppList_alloc() {
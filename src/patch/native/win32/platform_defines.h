@@ -29,6 +29,8 @@
 
 void* filterProxySymbol(const char* name, void* target);
 void* resolveSymbol(const char* symbol);
+// Looks up a function in the bundled LuaJIT library, or returns NULL if LuaJIT is not loaded.
+void* resolveLuaJITSymbol(const char* symbol);
 
 // std::list data structure
 typedef struct CppListLink {
@@ -32,10 +32,12 @@ extern symbolTable_type proxy_symbolTable[] __asm__("cif_symbolTable");
 
 __attribute__((constructor(CONSTRUCTOR_PROXY_INIT))) static void initProxy() {
     debug_print("Initializing CvGameDatabase proxy.");
+    PatchTransaction* transaction = PatchTransaction_begin("CvGameDatabase proxy");
     for(symbolTable_type* t = proxy_symbolTable; t->exists; t++) {
         void* target = filterProxySymbol(t->target, resolveSymbol(t->target));
         char buffer[1024];
         snprintf(buffer, 1024, "proxy initialization: %s", t->target);
-        patchJmpInstruction((void*) t->addr, target, buffer);
+        PatchTransaction_patchJmp(transaction, (void*) t->addr, target, buffer);
     }
+    PatchTransaction_commit(transaction);
 }
\ No newline at end of file
@@ -33,9 +33,11 @@ if _mpPatch_activateFrontEnd then
     local function setGameLaunch()
         gameLaunchSet = true
         gameLaunchCountdown = 3
+        _mpPatch.patch.gc.defer("launch")
     end
     _mpPatch.event.reset.registerHandler(function()
         gameLaunchSet = false
+        _mpPatch.patch.gc.resume("launch")
     end)
 
     _mpPatch.net.startLaunchCountdown.registerHandler(function(_, id)
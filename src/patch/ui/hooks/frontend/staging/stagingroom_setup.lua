@@ -46,16 +46,18 @@ if _mpPatch_activateFrontEnd then
     function StartCountdown()
         g_fCountdownTimer = 10
         countdownRunning = true
+        _mpPatch.patch.gc.defer("countdown")
     end
 
     function StopCountdown()
         Controls.CountdownButton:SetHide(true)
         g_fCountdownTimer = -1
         countdownRunning = false
+        _mpPatch.patch.gc.resume("countdown")
     end
 
     _mpPatch.event.reset.registerHandler(function()
-        _mpPatch.patch.NetPatch.reset()
+        _mpPatch.resetNetPatch()
         StopCountdown()
     end)
 end
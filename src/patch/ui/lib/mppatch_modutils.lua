@@ -20,20 +20,30 @@
 
 local patch = _mpPatch.patch
 
-function _mpPatch.forceReloadMods()
+-- NetPatch.install defers full collections until the override has been applied or reset.
+function _mpPatch.resetNetPatch()
     patch.NetPatch.reset()
+end
+
+function _mpPatch.forceReloadMods()
+    _mpPatch.resetNetPatch()
     patch.NetPatch.overrideReloadMods(true)
     patch.NetPatch.install()
 end
-function _mpPatch.overrideWithModList(list)
+-- If allowReloadSkip is set, and the native patch can tell the list is identical to the active one, a forced reload
+-- of the same mods is skipped. forceReloadMods never allows this, as it works around the database getting out of sync.
+function _mpPatch.overrideWithModList(list, allowReloadSkip)
     _mpPatch.debugPrint("Overriding mods...")
-    patch.NetPatch.reset()
-    for _, mod in ipairs(list) do
-        local id = mod.ID or mod.ModID
-        _mpPatch.debugPrint("- Adding mod ".._mpPatch.getModName(id, mod.Version).."...")
-        patch.NetPatch.pushMod(id, mod.Version)
+    _mpPatch.resetNetPatch()
+    if _mpPatch.debug then
+        for _, mod in ipairs(list) do
+            local id = mod.ID or mod.ModID
+            _mpPatch.debugPrint("- Adding mod ".._mpPatch.getModName(id, mod.Version).."...")
+        end
     end
+    patch.NetPatch.pushMods(list)
     patch.NetPatch.overrideModList()
+    patch.NetPatch.allowReloadSkip(allowReloadSkip)
     patch.NetPatch.install()
 end
 
@@ -46,7 +56,7 @@ end
 function _mpPatch.overrideModsFromPreGame()
     local modList = _mpPatch.decodeModsList()
     if modList and _mpPatch.isModding then
-        _mpPatch.overrideWithModList(modList)
+        _mpPatch.overrideWithModList(modList, true)
     end
 end
 _mpPatch._mt.registerProperty("areModsEnabled", function()
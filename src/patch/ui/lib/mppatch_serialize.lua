@@ -48,53 +48,9 @@ local function decode32(v)
         return v
     end
 end
-local function encode32(v)
-    if v > 0x7FFFFFFF then
-        return v - 0x100000000
-    else
-        return v
-    end
-end
 local function getGameOption(name)
     return decode32(PreGame.GetGameOption(mungeName(name)))
 end
-local function setGameOption(name, value)
-    return PreGame.SetGameOption(mungeName(name), encode32(value))
-end
-
------------------------------------------------------------------------------------------------------------------------
--- Utility function for encoding numbers in base 62
-
-local printableCharacters = {string.byte("0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ", 0, -1)}
-local printableCharacterCount = #printableCharacters
-local function encodeNumber(n)
-    local str = ""
-    while n >= printableCharacterCount do
-        str = str .. string.char(printableCharacters[(n % printableCharacterCount) + 1])
-        n = math.floor(n / printableCharacterCount)
-    end
-    return str .. string.char(printableCharacters[n])
-end
-
------------------------------------------------------------------------------------------------------------------------
--- Utility function for encoding uuids as 4 32-bit integers
-
-local uuidRegex = ("("..("[0-9a-fA-F]"):rep(8)..")"):rep(4)
-local function encodeUUID(uuidString)
-    uuidString = uuidString:gsub("-", "")
-    local uuids = {uuidString:match(uuidRegex)}
-    if #uuids ~= 4 or not uuids[1] then error("could not parse UUID") end
-    return _mpPatch.map(uuids, function(x) return tonumber(x, 16) end)
-end
-local function split32(v)
-    return math.floor(v / 0x10000), v % 0x10000
-end
-local function decodeUUID(table)
-    local a, b, c, d = unpack(table)
-    local b0, b1 = split32(b)
-    local c0, c1 = split32(c)
-    return string.format("%08x-%04x-%04x-%04x-%04x%08x", a, b0, b1, c0, c1, d)
-end
 
 -----------------------------------------------------------------------------------------------------------------------
 -- Enroll/decode mods into the PreGame option table
@@ -114,30 +70,18 @@ end
 -- #$id    = the length of mod $id's name
 -- $id~$i  = data block $i for mod $id's name
 --
--- $id and $i are encoded using encodeNumber in each of these functions. The UUID is encoded as 4 32-bit integers,
--- representing the whole UUID as a big endian 128-bit integer, and the mod's name is encoded into ceil(len / 4)
--- data blocks.
+-- $id and $i are encoded in base 62. The UUID is encoded as 4 32-bit integers, representing the whole UUID as a big
+-- endian 128-bit integer, and the mod's name is encoded into ceil(len / 4) data blocks.
+--
+-- The encoding itself is implemented natively in mod_codec.c, which builds every option name and value in one call
+-- and caches the option name strings between calls.
 
 local encodingVersionMajor = 1
-local encodingVersionMinor = 0
 
 local isModdingField    = "?"
 local majorVersionField = "V0"
-local minorVersionField = "V1"
 
-local modCountField     = "#"
-local function modVersionField(id)
-    return "!"..encodeNumber(id)
-end
-local function modUUIDBlockField(id, i)
-    return tostring(i)..encodeNumber(id)
-end
-local function modNameLengthField(id)
-    return "#"..encodeNumber(id)
-end
-local function modNameDataBlockField(id, i)
-    return encodeNumber(id).."~"..encodeNumber(i)
-end
+local modCodec = _mpPatch.patch.ModCodec
 
 _mpPatch._mt.registerProperty("isModding", function()
     return getGameOption(isModdingField) == 1
@@ -146,81 +90,21 @@ _mpPatch._mt.registerProperty("isSupportedVersion", function()
     return getGameOption(majorVersionField) == encodingVersionMajor
 end)
 
-local function enrollModName(id, name)
-    setGameOption(modNameLengthField(id), #name)
-
-    local j = 1
-    for i=1,#name,4 do
-        local a, b, c, d = name:byte(i, i+3)
-        a, b, c, d = a or 0, b or 0, c or 0, d or 0
-        local v = ((((a * 256) + b) * 256) + c) * 256 + d
-        setGameOption(modNameDataBlockField(id, j), v)
-        j = j + 1
-    end
-end
-local function enrollMod(id, uuid, version)
-    local modName = _mpPatch.getModName(uuid, version)
-    _mpPatch.debugPrint("- Enrolling mod "..modName)
-    setGameOption(modVersionField(id), version)
-    for i, v in ipairs(encodeUUID(uuid)) do
-        setGameOption(modUUIDBlockField(id, i), v)
-    end
-    enrollModName(id, modName)
-end
 function _mpPatch.enrollModsList(modList)
     _mpPatch.debugPrint("Enrolling mods...")
-    setGameOption(majorVersionField, encodingVersionMajor)
-    setGameOption(minorVersionField, encodingVersionMinor)
-    if #modList > 0 then
-        setGameOption(isModdingField, 1)
-        setGameOption(modCountField, #modList)
-        for i, v in ipairs(modList) do
-            enrollMod(i, v.ID, v.Version)
-        end
-    else
-        setGameOption(isModdingField, 0)
+    local mods = {}
+    for i, v in ipairs(modList) do
+        local modName = _mpPatch.getModName(v.ID, v.Version)
+        _mpPatch.debugPrint("- Enrolling mod "..modName)
+        mods[i] = { ID = v.ID, Version = v.Version, Name = modName }
     end
-end
-
-local function decodeModName(id)
-    local charTable = {}
 
-    local i = getGameOption(modNameLengthField(id))
-    local j = 1
-    while i > 0 do
-        local current = (j - 1) * 4 + 1
-
-        local v = getGameOption(modNameDataBlockField(id, j))
-        local a, b, c, d = math.floor(v / 0x1000000) % 0x100, math.floor(v / 0x10000) % 0x100,
-                           math.floor(v / 0x100) % 0x100, v % 0x100
-        if i >= 1 then charTable[current + 0] = string.char(a) end
-        if i >= 2 then charTable[current + 1] = string.char(b) end
-        if i >= 3 then charTable[current + 2] = string.char(c) end
-        if i >= 4 then charTable[current + 3] = string.char(d) end
-
-        i = i - 4
-        j = j + 1
-    end
-
-    return table.concat(charTable)
-end
-local function decodeMod(id)
-    local uuidTable = {}
-    for i=1,4 do
-        uuidTable[i] = getGameOption(modUUIDBlockField(id, i))
+    local options = modCodec.encodeModsList(mods)
+    for i=1,#options,2 do
+        PreGame.SetGameOption(options[i], options[i + 1])
     end
-    return {
-        ID      = decodeUUID(uuidTable),
-        Version = getGameOption(modVersionField(id)),
-        Name    = decodeModName(id)
-    }
 end
-function _mpPatch.decodeModsList()
-    if not _mpPatch.isModding then return nil end
 
-    local modList = {}
-    for i=1,getGameOption(modCountField) do
-        modList[i] = decodeMod(i)
-    end
-    return modList
-end
\ No newline at end of file
+function _mpPatch.decodeModsList()
+    return modCodec.decodeModsList(PreGame.GetGameOption)
+end
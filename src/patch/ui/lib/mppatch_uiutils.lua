@@ -51,9 +51,20 @@ function _mpPatch.setBIsModding()
 end
 
 -- Update function hooking
+--
+-- If gcUpdateBudgetMicros is set, each update also runs a slice of incremental garbage collection, so collection work
+-- is spread evenly over frames instead of happening at random points.
 function _mpPatch.hookUpdate()
     local onUpdate = _mpPatch.event.update
-    ContextPtr:SetUpdate(function(...) return onUpdate(...) end)
+    local gc = _mpPatch.patch.gc
+    if _mpPatch.patch.config.gcUpdateBudgetMicros > 0 then
+        ContextPtr:SetUpdate(function(...)
+            gc.step()
+            return onUpdate(...)
+        end)
+    else
+        ContextPtr:SetUpdate(function(...) return onUpdate(...) end)
+    end
 end
 function _mpPatch.unhookUpdate()
     ContextPtr:ClearUpdate()